@@ -0,0 +1,21 @@
+#version 330
+
+// From vertex shader
+in vec2 texcoord;
+in vec3 fcolor;
+in float electricity;
+
+// Application data
+uniform sampler2D sampler0;
+
+// Output color
+layout(location = 0) out vec4 color;
+
+void main()
+{
+	color = vec4(fcolor, 1.0) * texture(sampler0, vec2(texcoord.x, texcoord.y));
+
+	// Same electricity effect as the animated shader, only on instances that ask for it
+	float electricityOffset = sin(gl_FragCoord.y * 60.0);
+	color.z += electricity * electricityOffset;
+}
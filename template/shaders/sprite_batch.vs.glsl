@@ -0,0 +1,32 @@
+#version 330
+
+// Per-vertex attributes of the sprite quad
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec2 in_texcoord;
+
+// Per-instance attributes
+layout(location = 2) in vec3 in_transform_0;
+layout(location = 3) in vec3 in_transform_1;
+layout(location = 4) in vec3 in_transform_2;
+layout(location = 5) in vec4 in_uv_rect;
+layout(location = 6) in vec4 in_instance_color;
+
+// Passed to fragment shader
+out vec2 texcoord;
+out vec3 fcolor;
+out float electricity;
+
+// Application data
+uniform mat3 projection;
+
+void main()
+{
+	// uv_rect holds the offset and size of the sprite's region of the texture
+	texcoord = in_uv_rect.xy + in_texcoord * in_uv_rect.zw;
+	fcolor = in_instance_color.rgb;
+	electricity = in_instance_color.a;
+
+	mat3 transform = mat3(in_transform_0, in_transform_1, in_transform_2);
+	vec3 pos = projection * transform * vec3(in_position.xy, 1.0);
+	gl_Position = vec4(pos.xy, in_position.z, 1.0);
+}
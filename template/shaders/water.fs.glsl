@@ -3,6 +3,14 @@
 uniform sampler2D screen_texture;
 uniform float time;
 uniform float screen_darken_factor;
+// Which of the effects below are on, see PostProcessSettings
+uniform int post_effects;
+// Part of screen_texture the world was drawn to, see dynamic resolution in RenderSystem
+uniform vec2 render_scale;
+
+const int POST_EFFECT_DISTORTION = 1;
+const int POST_EFFECT_COLOR_SHIFT = 2;
+const int POST_EFFECT_FADE = 4;
 
 in vec2 texcoord;
 
@@ -28,16 +36,21 @@ vec4 color_shift(vec4 in_color)
 
 vec4 fade_color(vec4 in_color) 
 {
-	if (screen_darken_factor > 0)
-		in_color -= screen_darken_factor * vec4(0.8, 0.8, 0.8, 0);
+	in_color -= screen_darken_factor * vec4(0.8, 0.8, 0.8, 0);
 	return in_color;
 }
 
 void main()
 {
-	vec2 coord = distort(texcoord);
-
-    vec4 in_color = texture(screen_texture, coord);
-    color = color_shift(in_color);
-    color = fade_color(color);
-}
\ No newline at end of file
+	vec2 coord = texcoord;
+	if ((post_effects & POST_EFFECT_DISTORTION) != 0)
+		coord = distort(coord);
+
+	// Upscale the scaled world, without filtering in texels outside of it
+	vec2 texel_limit = render_scale - 0.5 / vec2(textureSize(screen_texture, 0));
+    color = texture(screen_texture, min(coord * render_scale, texel_limit));
+	if ((post_effects & POST_EFFECT_COLOR_SHIFT) != 0)
+		color = color_shift(color);
+	if ((post_effects & POST_EFFECT_FADE) != 0)
+		color = fade_color(color);
+}
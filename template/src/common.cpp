@@ -1,5 +1,11 @@
 #include "common.hpp"
 
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
 // Note, we could also use the functions from GLM but we write the transformations here to show the uderlying math
 void Transform::scale(vec2 scale)
 {
@@ -55,4 +61,25 @@ bool gl_has_errors()
 	}
 
 	return true;
-}
\ No newline at end of file
+}
+
+void create_cache_dir()
+{
+#ifdef _WIN32
+	_mkdir(cache_path("").c_str());
+#else
+	mkdir(cache_path("").c_str(), 0755);
+#endif
+}
+
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
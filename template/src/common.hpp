@@ -1,6 +1,8 @@
 #pragma once
 
 // stlib
+#include <cstddef>
+#include <cstdint>
 #include <fstream> // stdout, stderr..
 #include <string>
 #include <tuple>
@@ -29,6 +31,12 @@ inline std::string shader_path(const std::string& name) {return std::string(PROJ
 inline std::string textures_path(const std::string& name) {return data_path() + "/textures/" + std::string(name);};
 inline std::string audio_path(const std::string& name) {return data_path() + "/audio/" + std::string(name);};
 inline std::string mesh_path(const std::string& name) {return data_path() + "/meshes/" + std::string(name);};
+// Generated files (cooked textures, program binaries), safe to delete
+inline std::string cache_path(const std::string& name) {return data_path() + "/cache/" + std::string(name);};
+void create_cache_dir();
+
+// FNV-1a, pass the previous result as seed to hash several buffers as one
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
 
 const int window_width_px = 1200;
 const int window_height_px = 800;
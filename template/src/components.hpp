@@ -32,6 +32,8 @@ struct Player
 	Keybinds keybinds;
 	// If player is colliding with a platmorm, they are grounded
 	bool is_grounded = false;
+	// Number of platform contacts currently supporting the player
+	int ground_contacts = 0;
 	// Direction player is facing for sprite (default facing right)
 	bool facing_right = true;
 	// Max number of jumps allowed in the air
@@ -186,12 +188,8 @@ struct AnimatedSprite {
 	std::map<int, int> frame_count_per_type = {};
 };
 
-// Platforms
-struct Platform
-{
-	bool collider_active_player1 = true;
-	bool collider_active_player2 = true;
-};
+// Tag for platforms, their one-way state lives in PlayerPlatformContact::collider_active
+struct Platform {};
 
 // Background
 struct Background
@@ -205,6 +203,13 @@ struct Friction
 
 };
 
+// Bodies that the physics system may put to sleep once they come to rest
+struct RestingBody
+{
+	// Number of consecutive physics steps the body has stayed below the rest threshold
+	int rest_steps = 0;
+};
+
 // Gravity
 struct Gravity
 {
@@ -236,11 +241,16 @@ struct ParallaxBackground
 };
 
 // All data relevant to the shape and motion of entities
+// The fields read by integration (position, velocity) and the AABB test (position, scale) come first
+// and are packed back to back, the angle is only read by the renderer.
+// Stored as float even with DETERMINISTIC_PHYSICS, the physics converts to phys_scalar every step
 struct Motion {
 	vec2 position = { 0.f, 0.f };
-	float angle = 0.f;
 	vec2 velocity = { 0.f, 0.f };
 	vec2 scale = { 10.f, 10.f };
+	float angle = 0.f;
+	// Sleeping bodies are skipped by integration until they are woken up
+	bool is_sleeping = false;
 };
 
 // Component to store text rendering data
@@ -275,6 +285,15 @@ struct PlayerPlatformCollision
 	PlayerPlatformCollision(Entity& other_entity) { this->other_entity = other_entity; };
 };
 
+// Persistent data of a player-platform contact
+struct PlayerPlatformContact
+{
+	// True while the platform is holding the player up
+	bool supporting = false;
+	// One-way platforms only collide with players whose feet were above their top at the start of the step
+	bool collider_active = false;
+};
+
 struct PlayerCollectibleCollisions
 {
 	// Note, the first object is stored in the ECS container.entities
@@ -440,7 +459,9 @@ enum class EFFECT_ASSET_ID {
 	BACKGROUND = WATER + 1,
 	ANIMATED = BACKGROUND + 1,
 	BULLET = ANIMATED + 1,
-	EFFECT_COUNT = BULLET + 1
+	SPRITE_BATCH = BULLET + 1,
+	TEXT = SPRITE_BATCH + 1,
+	EFFECT_COUNT = TEXT + 1
 };
 const int effect_count = (int)EFFECT_ASSET_ID::EFFECT_COUNT;
 
@@ -457,10 +478,26 @@ enum class GEOMETRY_BUFFER_ID {
 };
 const int geometry_count = (int)GEOMETRY_BUFFER_ID::GEOMETRY_COUNT;
 
+// Draw layers, lower layers are drawn first
+enum class RENDER_LAYER {
+	BACKGROUND_BACK = 0,
+	BACKGROUND_MIDDLE = BACKGROUND_BACK + 1,
+	BACKGROUND_FRONT = BACKGROUND_MIDDLE + 1,
+	MAP = BACKGROUND_FRONT + 1,
+	PICKUPS = MAP + 1,
+	PLAYERS = PICKUPS + 1,
+	WEAPONS = PLAYERS + 1,
+	MUZZLE_FLASHES = WEAPONS + 1,
+	PROJECTILES = MUZZLE_FLASHES + 1,
+	HUD = PROJECTILES + 1,
+	LAYER_COUNT = HUD + 1
+};
+
 struct RenderRequest {
 	TEXTURE_ASSET_ID used_texture = TEXTURE_ASSET_ID::TEXTURE_COUNT;
 	EFFECT_ASSET_ID used_effect = EFFECT_ASSET_ID::EFFECT_COUNT;
 	GEOMETRY_BUFFER_ID used_geometry = GEOMETRY_BUFFER_ID::GEOMETRY_COUNT;
+	RENDER_LAYER layer = RENDER_LAYER::HUD;
 };
 
 
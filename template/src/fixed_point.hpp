@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "common.hpp"
+
+// Q16.16 fixed point number used by the deterministic physics mode.
+// All arithmetic is done on integers (with 64 bit intermediates for products and quotients),
+// so the results do not depend on the compiler's floating point contraction or the FPU.
+// Conversions from and to float are not exact, but they are correctly rounded and so give the same
+// result on every build: a float below 128 in magnitude has more fraction bits than the 16 kept here,
+// and a fixed value of 256 or more has more significant bits than the 24 of a float.
+struct Fixed
+{
+	static const int FRACTION_BITS = 16;
+	static const int32_t ONE = 1 << FRACTION_BITS;
+
+	int32_t raw = 0;
+
+	Fixed() {}
+	Fixed(float value) : raw(raw_from_float(value)) {}
+
+	// Saturates outside of the representable range [-32768, 32768) instead of wrapping around
+	static int32_t raw_from_float(float value)
+	{
+		const float scaled = value * (float)ONE;
+		if (scaled != scaled)
+			return 0;
+		if (scaled >= (float)INT32_MAX)
+			return INT32_MAX;
+		if (scaled <= (float)INT32_MIN)
+			return INT32_MIN;
+		return (int32_t)lroundf(scaled);
+	}
+
+	static Fixed from_raw(int32_t raw_value)
+	{
+		Fixed result;
+		result.raw = raw_value;
+		return result;
+	}
+
+	float to_float() const { return (float)raw / (float)ONE; }
+
+	Fixed operator-() const { return from_raw(-raw); }
+	Fixed operator+(Fixed other) const { return from_raw(raw + other.raw); }
+	Fixed operator-(Fixed other) const { return from_raw(raw - other.raw); }
+	Fixed operator*(Fixed other) const { return from_raw((int32_t)(((int64_t)raw * other.raw) >> FRACTION_BITS)); }
+	Fixed operator/(Fixed other) const { return from_raw((int32_t)(((int64_t)raw << FRACTION_BITS) / other.raw)); }
+
+	Fixed& operator+=(Fixed other) { raw += other.raw; return *this; }
+	Fixed& operator-=(Fixed other) { raw -= other.raw; return *this; }
+	Fixed& operator*=(Fixed other) { *this = *this * other; return *this; }
+
+	bool operator==(Fixed other) const { return raw == other.raw; }
+	bool operator!=(Fixed other) const { return raw != other.raw; }
+	bool operator<(Fixed other) const { return raw < other.raw; }
+	bool operator<=(Fixed other) const { return raw <= other.raw; }
+	bool operator>(Fixed other) const { return raw > other.raw; }
+	bool operator>=(Fixed other) const { return raw >= other.raw; }
+};
+
+inline Fixed abs(Fixed value) { return value.raw < 0 ? -value : value; }
+
+// Scalar type used by the physics math. Build with DETERMINISTIC_PHYSICS to run the
+// simulation in fixed point. Components keep storing floats either way, so every step converts the
+// state in and out and quantises it to values both types hold, which stays deterministic.
+#ifdef DETERMINISTIC_PHYSICS
+typedef Fixed phys_scalar;
+inline float to_float(phys_scalar value) { return value.to_float(); }
+#else
+typedef float phys_scalar;
+inline float to_float(phys_scalar value) { return value; }
+#endif
+
+inline phys_scalar to_phys(float value) { return phys_scalar(value); }
+
+// 2D vector in the physics scalar type
+struct phys_vec2
+{
+	phys_scalar x;
+	phys_scalar y;
+
+	phys_vec2 operator+(const phys_vec2& other) const { return { x + other.x, y + other.y }; }
+	phys_vec2 operator-(const phys_vec2& other) const { return { x - other.x, y - other.y }; }
+	phys_vec2 operator*(phys_scalar factor) const { return { x * factor, y * factor }; }
+};
+
+inline phys_vec2 to_phys(vec2 value) { return { to_phys(value.x), to_phys(value.y) }; }
+inline vec2 to_vec2(const phys_vec2& value) { return { to_float(value.x), to_float(value.y) }; }
@@ -0,0 +1,115 @@
+#include "frame_pacer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+bool FramePacer::parse(const char* text, FramePacing& mode, float& cap)
+{
+	if (strcmp(text, "vsync") == 0)
+		mode = FramePacing::VSYNC;
+	else if (strcmp(text, "adaptive") == 0)
+		mode = FramePacing::ADAPTIVE;
+	else if (strcmp(text, "uncapped") == 0)
+		mode = FramePacing::UNCAPPED;
+	else
+	{
+		char* end = nullptr;
+		const float fps = strtof(text, &end);
+		if (end == text || *end != '\0' || fps <= 0.f)
+			return false;
+		mode = FramePacing::CAPPED;
+		cap = fps;
+	}
+	return true;
+}
+
+void FramePacer::configure(FramePacing mode, float cap)
+{
+	pacing = mode;
+	cap_fps = cap;
+	period = Clock::duration::zero();
+	if (pacing == FramePacing::CAPPED)
+		period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / cap_fps));
+	frame_intervals = FrameTimings();
+	frame_intervals.capacity = HISTORY_FRAMES;
+	started = false;
+}
+
+int FramePacer::swapInterval() const
+{
+	switch (pacing)
+	{
+	case FramePacing::VSYNC:
+		return 1;
+	case FramePacing::ADAPTIVE:
+		return -1;
+	default:
+		return 0;
+	}
+}
+
+void FramePacer::waitUntil(Clock::time_point deadline)
+{
+	Clock::time_point now = Clock::now();
+	if (deadline - now > spin_margin)
+	{
+		const Clock::time_point wake = deadline - spin_margin;
+		std::this_thread::sleep_until(wake);
+		now = Clock::now();
+		// Widen the margin right away when the sleep overshot it, narrow it slowly otherwise
+		const Clock::duration overshoot = now - wake;
+		if (overshoot > spin_margin)
+			spin_margin = std::min<Clock::duration>(overshoot + std::chrono::microseconds(250), std::chrono::milliseconds(4));
+		else
+			spin_margin = std::max<Clock::duration>(spin_margin - std::chrono::microseconds(10), std::chrono::microseconds(500));
+	}
+	while (Clock::now() < deadline)
+		std::this_thread::yield();
+}
+
+void FramePacer::endFrame()
+{
+	if (pacing == FramePacing::CAPPED && started)
+	{
+		// Frames that missed their deadline by a whole period start a new schedule
+		// rather than rushing to catch up
+		next_deadline += period;
+		if (Clock::now() > next_deadline + period)
+			next_deadline = Clock::now();
+		waitUntil(next_deadline);
+	}
+
+	const Clock::time_point now = Clock::now();
+	if (started)
+		frame_intervals.add(std::chrono::duration<float, std::milli>(now - last_frame).count());
+	else
+		next_deadline = now;
+	last_frame = now;
+	started = true;
+}
+
+float FramePacer::jitter() const
+{
+	const std::vector<float>& samples = frame_intervals.samples;
+	if (samples.size() < 2)
+		return 0.f;
+	const float mean = frame_intervals.mean();
+	double sum = 0.0;
+	for (float sample : samples)
+		sum += (sample - mean) * (sample - mean);
+	return (float)std::sqrt(sum / (samples.size() - 1));
+}
+
+void FramePacer::report(FILE* file) const
+{
+	static const char* mode_names[] = { "vsync", "adaptive", "uncapped", "capped" };
+	fprintf(file, "Frame pacing %s", mode_names[(int)pacing]);
+	if (pacing == FramePacing::CAPPED)
+		fprintf(file, " at %.1f fps (%.3f ms)", cap_fps, 1000.f / cap_fps);
+	fprintf(file, ": interval mean %.3f ms, p50 %.3f, p99 %.3f, max %.3f, jitter %.3f ms over %d frames\n",
+		frame_intervals.mean(), frame_intervals.percentile(50.f), frame_intervals.percentile(99.f),
+		frame_intervals.max(), jitter(), (int)frame_intervals.samples.size());
+}
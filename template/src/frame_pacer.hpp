@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+#include "frame_timings.hpp"
+
+// How frames are paced once they are presented
+enum class FramePacing {
+	VSYNC,    // swap on every vertical blank
+	ADAPTIVE, // vsync, but late frames swap right away and tear (EXT_swap_control_tear)
+	UNCAPPED, // swap immediately, for benchmarks
+	CAPPED    // no vsync, the pacer waits for a fixed frame rate
+};
+
+// Paces presented frames and measures the achieved frame intervals. Capped frames wait with a
+// hybrid timer: the OS sleeps until shortly before the deadline, which it tends to overshoot
+// by up to a millisecond or two, and the remainder is spun away for sub millisecond accuracy.
+class FramePacer
+{
+public:
+	static const int HISTORY_FRAMES = 600;
+
+	FramePacer() { frame_intervals.capacity = HISTORY_FRAMES; }
+
+	// Parses vsync, adaptive, uncapped or a frame rate cap such as 144, false if it is none of them
+	static bool parse(const char* text, FramePacing& mode, float& cap_fps);
+
+	void configure(FramePacing mode, float cap_fps);
+	FramePacing mode() const { return pacing; }
+	// Swap interval for glfwSwapInterval, -1 asks for adaptive vsync
+	int swapInterval() const;
+
+	// Call right after presenting a frame, waits for the cap and records the interval
+	void endFrame();
+
+	// Intervals between presented frames over the last HISTORY_FRAMES frames, in ms
+	const FrameTimings& intervals() const { return frame_intervals; }
+	// Standard deviation of the intervals, in ms
+	float jitter() const;
+	void report(FILE* file) const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	void waitUntil(Clock::time_point deadline);
+
+	FramePacing pacing = FramePacing::VSYNC;
+	float cap_fps = 0.f;
+	Clock::duration period = Clock::duration::zero();
+	Clock::time_point next_deadline;
+	Clock::time_point last_frame;
+	bool started = false;
+	// How early the sleep ends before the deadline, grows with the overshoot the OS shows
+	Clock::duration spin_margin = std::chrono::microseconds(1500);
+	FrameTimings frame_intervals;
+};
@@ -0,0 +1,49 @@
+#include "frame_timings.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void FrameTimings::add(float ms)
+{
+	if (capacity == 0 || samples.size() < capacity)
+	{
+		samples.push_back(ms);
+		return;
+	}
+	samples[oldest] = ms;
+	oldest = (oldest + 1) % capacity;
+}
+
+float FrameTimings::mean() const
+{
+	if (samples.empty())
+		return 0.f;
+	double sum = 0.0;
+	for (float sample : samples)
+		sum += sample;
+	return (float)(sum / samples.size());
+}
+
+float FrameTimings::percentile(float p) const
+{
+	if (samples.empty())
+		return 0.f;
+	std::vector<float> sorted = samples;
+	size_t rank = (size_t)std::ceil(p / 100.f * sorted.size());
+	rank = std::min(std::max(rank, (size_t)1), sorted.size());
+	std::nth_element(sorted.begin(), sorted.begin() + (rank - 1), sorted.end());
+	return sorted[rank - 1];
+}
+
+float FrameTimings::max() const
+{
+	if (samples.empty())
+		return 0.f;
+	return *std::max_element(samples.begin(), samples.end());
+}
+
+void FrameTimings::write(FILE* file, const char* name) const
+{
+	fprintf(file, "%-12s %8.3f %8.3f %8.3f %8.3f %8.3f\n",
+		name, mean(), percentile(50.f), percentile(95.f), percentile(99.f), max());
+}
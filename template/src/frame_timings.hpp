@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+// Durations of a series of frames in ms, summarised as the mean and percentiles
+struct FrameTimings
+{
+	std::vector<float> samples;
+	// When non zero only the latest capacity samples are kept, the oldest one is overwritten
+	size_t capacity = 0;
+	size_t oldest = 0;
+
+	void add(float ms);
+	float mean() const;
+	// Nearest rank percentile, p in [0, 100]
+	float percentile(float p) const;
+	float max() const;
+
+	// One "name mean p50 p95 p99 max" line
+	void write(FILE* file, const char* name) const;
+};
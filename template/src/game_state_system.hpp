@@ -32,7 +32,7 @@ public:
     GLFWwindow* create_window();
     bool is_over()const;
 
-	GLFWwindow* window;
+	GLFWwindow* window = nullptr;
     bool is_state_changed = false;
     bool is_quit = false;
     int winner = -1;
@@ -44,8 +44,8 @@ private:
     int currentLevel = 0;
 
     // music references
-	Mix_Music* background_music;
-	Mix_Chunk* salmon_dead_sound;
-	Mix_Chunk* salmon_eat_sound;
+	Mix_Music* background_music = nullptr;
+	Mix_Chunk* salmon_dead_sound = nullptr;
+	Mix_Chunk* salmon_eat_sound = nullptr;
      
 };
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "gpu_profiler.hpp"
+
+void GpuProfiler::init()
+{
+	for (auto& frame_queries : queries)
+		glGenQueries(render_pass_count, frame_queries.data());
+	for (auto& frame_pending : pending)
+		frame_pending.fill(false);
+	query_frame_numbers.fill(0);
+	latest_ms.fill(-1.f);
+	for (FrameTimings& timings : pass_timings)
+		timings.capacity = HISTORY_FRAMES;
+	initialized = true;
+	gl_has_errors();
+}
+
+void GpuProfiler::destroy()
+{
+	if (initialized)
+	{
+		for (auto& frame_queries : queries)
+			glDeleteQueries(render_pass_count, frame_queries.data());
+		initialized = false;
+	}
+	if (log != nullptr)
+	{
+		fclose(log);
+		log = nullptr;
+	}
+}
+
+bool GpuProfiler::openLog(const std::string& path)
+{
+	log = fopen(path.c_str(), "w");
+	if (log == nullptr)
+	{
+		fprintf(stderr, "Could not write the GPU profile %s\n", path.c_str());
+		return false;
+	}
+	fprintf(log, "# frame world_ms post_ms text_ms\n");
+	return true;
+}
+
+void GpuProfiler::beginFrame()
+{
+	if (!initialized)
+		return;
+	frame_number++;
+	current = (int)(frame_number % QUERY_FRAMES);
+
+	// The set about to be reused was issued QUERY_FRAMES frames ago, by now its results
+	// are normally available without stalling
+	const auto now = std::chrono::steady_clock::now();
+	const float issued_ms = std::chrono::duration<float, std::milli>(now - query_issue_times[current]).count();
+	std::array<float, render_pass_count>& frame_ms = latest_ms;
+	frame_ms.fill(-1.f);
+	bool any = false;
+	for (int pass = 0; pass < render_pass_count; pass++)
+	{
+		if (!pending[current][pass])
+			continue;
+		pending[current][pass] = false;
+
+		GLint available = 0;
+		glGetQueryObjectiv(queries[current][pass], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+		{
+			dropped_results++;
+			continue;
+		}
+		GLuint64 elapsed_ns = 0;
+		glGetQueryObjectui64v(queries[current][pass], GL_QUERY_RESULT, &elapsed_ns);
+		// No pass takes longer than the time since it was issued. llvmpipe reports garbage for
+		// the first query of a context.
+		const float elapsed_ms = (float)(elapsed_ns / 1e6);
+		if (elapsed_ms > issued_ms)
+		{
+			dropped_results++;
+			continue;
+		}
+		frame_ms[pass] = elapsed_ms;
+		pass_timings[pass].add(elapsed_ms);
+		any = true;
+	}
+
+	if (log != nullptr && any)
+	{
+		fprintf(log, "%llu", (unsigned long long)query_frame_numbers[current]);
+		for (float ms : frame_ms)
+			fprintf(log, " %.4f", ms);
+		fprintf(log, "\n");
+	}
+	query_frame_numbers[current] = frame_number;
+	query_issue_times[current] = now;
+}
+
+void GpuProfiler::begin(RenderPass pass)
+{
+	if (initialized)
+		glBeginQuery(GL_TIME_ELAPSED, queries[current][(int)pass]);
+}
+
+void GpuProfiler::end(RenderPass pass)
+{
+	if (!initialized)
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+	pending[current][(int)pass] = true;
+}
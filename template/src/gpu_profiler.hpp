@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "common.hpp"
+#include "frame_timings.hpp"
+
+// Render passes timed on the GPU, in the order a frame runs them
+enum class RenderPass {
+	WORLD = 0,
+	POST = WORLD + 1,
+	TEXT = POST + 1,
+	RENDER_PASS_COUNT = TEXT + 1
+};
+const int render_pass_count = (int)RenderPass::RENDER_PASS_COUNT;
+
+// GL_TIME_ELAPSED queries around each render pass. Every frame uses its own set of queries from a
+// ring and reads back the set it used QUERY_FRAMES frames earlier, so the CPU never waits for the
+// GPU to finish a pass. Results not available by then are dropped rather than waited for.
+// Must only be used on the thread the GL context is current on.
+class GpuProfiler
+{
+public:
+	static const int QUERY_FRAMES = 4;
+	// Frames the rolling averages and percentiles cover
+	static const int HISTORY_FRAMES = 600;
+
+	void init();
+	void destroy();
+
+	// Collects the finished results of the oldest query set, call once at the start of a frame
+	void beginFrame();
+	void begin(RenderPass pass);
+	void end(RenderPass pass);
+
+	// Rolling GPU times of a pass in ms, over the last HISTORY_FRAMES frames that ran it
+	const FrameTimings& timings(RenderPass pass) const { return pass_timings[(int)pass]; }
+	// Result read back by this frame's beginFrame, -1 when there was none
+	float latest(RenderPass pass) const { return latest_ms[(int)pass]; }
+	// Results that were not available in time or not plausible
+	int droppedResults() const { return dropped_results; }
+
+	// Appends one "frame world post text" line of ms per frame once its results are back,
+	// passes a frame skipped are logged as -1
+	bool openLog(const std::string& path);
+
+private:
+	std::array<std::array<GLuint, render_pass_count>, QUERY_FRAMES> queries;
+	std::array<std::array<bool, render_pass_count>, QUERY_FRAMES> pending;
+	std::array<uint64_t, QUERY_FRAMES> query_frame_numbers;
+	std::array<std::chrono::steady_clock::time_point, QUERY_FRAMES> query_issue_times;
+	std::array<FrameTimings, render_pass_count> pass_timings;
+	std::array<float, render_pass_count> latest_ms;
+	uint64_t frame_number = 0;
+	int current = 0;
+	int dropped_results = 0;
+	bool initialized = false;
+	FILE* log = nullptr;
+};
@@ -1,6 +1,7 @@
 #include "gun_system.hpp"
 #include "sound_system.hpp"
 #include "world_init.hpp"
+#include "physics_system.hpp"
 #include "stat_util.cpp"
 #include "create_gun_util.cpp"
 
@@ -243,6 +244,8 @@ void GunSystem::step(float elapsed_ms_since_last_update)
         // Drop the used weapon
         registry.gravity.emplace(entity_i);
         registry.nonInteractables.emplace(entity_i);
+        registry.restingBodies.emplace(entity_i);
+        PhysicsSystem::wake(entity_i);
         registry.guns.remove(entity_i);
     }
 }
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include "headless_context.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+namespace
+{
+	bool has_extension(const char* extensions, const char* name)
+	{
+		if (extensions == nullptr)
+			return false;
+		const size_t length = strlen(name);
+		for (const char* found = strstr(extensions, name); found != nullptr; found = strstr(found + length, name))
+		{
+			// Whole words only, some extension names are prefixes of others
+			const bool starts = found == extensions || found[-1] == ' ';
+			const bool ends = found[length] == ' ' || found[length] == '\0';
+			if (starts && ends)
+				return true;
+		}
+		return false;
+	}
+
+	// The surfaceless platform needs neither X nor a GPU, the default display is the fallback
+	EGLDisplay open_display()
+	{
+		const char* client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+		if (has_extension(client_extensions, "EGL_MESA_platform_surfaceless"))
+		{
+			PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+				(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+			if (get_platform_display != nullptr)
+			{
+				EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+				if (display != EGL_NO_DISPLAY)
+					return display;
+			}
+		}
+		return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+}
+
+bool HeadlessContext::create()
+{
+	EGLDisplay egl_display = open_display();
+	EGLint major, minor;
+	if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, &major, &minor))
+	{
+		fprintf(stderr, "Failed to initialize EGL (0x%x)\n", eglGetError());
+		return false;
+	}
+	display = egl_display;
+
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		fprintf(stderr, "EGL does not support desktop OpenGL\n");
+		destroy();
+		return false;
+	}
+
+	const EGLint config_attributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint config_count = 0;
+	if (!eglChooseConfig(egl_display, config_attributes, &config, 1, &config_count) || config_count == 0)
+	{
+		fprintf(stderr, "No EGL config for offscreen OpenGL rendering\n");
+		destroy();
+		return false;
+	}
+
+	// Same version and profile as the window context, see GameStateSystem::create_window
+	const EGLint context_attributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext egl_context = eglCreateContext(egl_display, config, EGL_NO_CONTEXT, context_attributes);
+	if (egl_context == EGL_NO_CONTEXT)
+	{
+		fprintf(stderr, "Failed to create an OpenGL 3.3 context (0x%x)\n", eglGetError());
+		destroy();
+		return false;
+	}
+	context = egl_context;
+
+	// The renderer draws into its own framebuffer, the pbuffer only exists to make the
+	// context current on drivers without surfaceless contexts
+	EGLSurface egl_surface = EGL_NO_SURFACE;
+	if (!has_extension(eglQueryString(egl_display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context"))
+	{
+		const EGLint pbuffer_attributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		egl_surface = eglCreatePbufferSurface(egl_display, config, pbuffer_attributes);
+		if (egl_surface == EGL_NO_SURFACE)
+		{
+			fprintf(stderr, "Failed to create an EGL pbuffer (0x%x)\n", eglGetError());
+			destroy();
+			return false;
+		}
+		surface = egl_surface;
+	}
+
+	if (!eglMakeCurrent(egl_display, egl_surface, egl_surface, egl_context))
+	{
+		fprintf(stderr, "Failed to make the headless context current (0x%x)\n", eglGetError());
+		destroy();
+		return false;
+	}
+
+	printf("Headless EGL %d.%d context (%s)\n", major, minor, surface != nullptr ? "pbuffer" : "surfaceless");
+	return true;
+}
+
+void HeadlessContext::destroy()
+{
+	if (display == nullptr)
+		return;
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (surface != nullptr)
+		eglDestroySurface(display, surface);
+	if (context != nullptr)
+		eglDestroyContext(display, context);
+	eglTerminate(display);
+	display = nullptr;
+	context = nullptr;
+	surface = nullptr;
+}
+
+bool HeadlessContext::makeCurrent(bool current)
+{
+	if (display == nullptr)
+		return false;
+	const bool made = current
+		? eglMakeCurrent(display, surface, surface, context)
+		: eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (!made)
+		fprintf(stderr, "Failed to %s the headless context (0x%x)\n", current ? "make current" : "release", eglGetError());
+	return made;
+}
+
+#else
+
+bool HeadlessContext::create()
+{
+	fprintf(stderr, "Headless rendering needs EGL, which this build was configured without\n");
+	return false;
+}
+
+void HeadlessContext::destroy()
+{
+}
+
+bool HeadlessContext::makeCurrent(bool)
+{
+	return false;
+}
+
+#endif
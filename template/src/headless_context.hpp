@@ -0,0 +1,22 @@
+#pragma once
+
+// Offscreen OpenGL 3.3 core context for rendering without a window or a display, e.g. on
+// Mesa's llvmpipe on CI hosts. Created through EGL's surfaceless platform, falling back to the
+// default display with a small pbuffer. Only available when the build found EGL (HEADLESS_EGL).
+class HeadlessContext
+{
+public:
+	// Creates the context and makes it current on the calling thread
+	bool create();
+	void destroy();
+	// Makes the context current on the calling thread, or releases it from the calling thread
+	bool makeCurrent(bool current);
+
+	~HeadlessContext() { destroy(); }
+
+private:
+	// EGLDisplay, EGLContext and EGLSurface, kept opaque so EGL stays out of this header
+	void* display = nullptr;
+	void* context = nullptr;
+	void* surface = nullptr;
+};
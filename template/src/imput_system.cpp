@@ -31,10 +31,16 @@ void InputSystem::init(RenderSystem* renderer_arg, GameStateSystem* game_state_s
 
 
 void InputSystem::on_key(int key, int, int action, int mod) {
+    // F3 shows the GPU time of the render passes on any screen
+    if (action == GLFW_RELEASE && key == GLFW_KEY_F3)
+        renderer->show_gpu_overlay = !renderer->show_gpu_overlay;
+
     if (game_state_system->get_current_state() == 0) {
         main_menu_system->on_key(key, action, mod);
     }
     else if (!world_system->paused) {
+        if (match_recording && game_state_system->get_current_state() == 2)
+            match_recording->record(key, action, mod);
         world_system->on_key(key, action, mod);
     }
 
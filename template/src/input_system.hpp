@@ -9,6 +9,7 @@
 #include "world_system.hpp"
 #include "main_menu_system.hpp"
 #include "story_system.hpp"
+#include "match_recording.hpp"
 
 class InputSystem
 
@@ -21,6 +22,7 @@ private:
     WorldSystem* world_system;
     MainMenuSystem* main_menu_system;
     StorySystem* story_system;
+    MatchRecording* match_recording = nullptr;
 
 public:
     void init(RenderSystem* renderer_arg, GameStateSystem* game_state_system, GLFWwindow* window, WorldSystem* world_system, MainMenuSystem* main_menu_system, StorySystem* story_system);
@@ -30,6 +32,9 @@ public:
     void on_click();
     void on_mouse_move(vec2 mouse_position);
 
+    // Records the key events of every match into recording, see --record-match
+    void record_match(MatchRecording* recording) { match_recording = recording; }
+
     InputSystem()
     {
     }
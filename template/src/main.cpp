@@ -4,6 +4,8 @@
 
 // stlib
 #include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <thread>
 // internal
 #include "physics_system.hpp"
@@ -23,12 +25,116 @@
 #include "story_system.hpp"
 #include "world_init.hpp"
 #include "camera_control_system.hpp"
+#include "headless_context.hpp"
+#include "match_recording.hpp"
+#include "frame_timings.hpp"
 
 using Clock = std::chrono::high_resolution_clock;
 
+// Simulation step of a headless frame, fixed so every run replays the same match
+const float HEADLESS_FRAME_MS = 1000.f / 60.f;
+// Simulation rate with --render-thread, draw() no longer waits for vsync so the loop paces itself
+const float SIMULATION_TICK_HZ = 120.f;
+
+static float ms_between(Clock::time_point start, Clock::time_point end)
+{
+	return (float)(std::chrono::duration_cast<std::chrono::microseconds>(end - start)).count() / 1000;
+}
+
+// Writes the frame time summary of a headless benchmark to the file and stdout
+static void write_benchmark_stats(const char* path, int level, const FrameTimings& frame_times,
+	const FrameTimings& simulation_times, const FrameTimings& render_times, const RenderSystem& render_system)
+{
+	const GpuProfiler& gpu_profiler = render_system.getGpuProfiler();
+	FILE* file = fopen(path, "w");
+	if (file == nullptr)
+		fprintf(stderr, "Could not write the benchmark stats %s\n", path);
+	FILE* outputs[] = { stdout, file };
+	for (FILE* out : outputs)
+	{
+		if (out == nullptr)
+			continue;
+		fprintf(out, "frames %d\n", (int)frame_times.samples.size());
+		fprintf(out, "frames drawn %d\n", (int)render_system.getFramesDrawn());
+		fprintf(out, "level %d\n", level);
+		fprintf(out, "resolution %dx%d\n", window_width_px, window_height_px);
+		fprintf(out, "renderer %s\n", (const char*)glGetString(GL_RENDERER));
+		fprintf(out, "%-12s %8s %8s %8s %8s %8s\n", "# ms", "mean", "p50", "p95", "p99", "max");
+		frame_times.write(out, "frame");
+		simulation_times.write(out, "simulation");
+		render_times.write(out, "render");
+		// Over the last GpuProfiler::HISTORY_FRAMES frames
+		gpu_profiler.timings(RenderPass::WORLD).write(out, "gpu_world");
+		gpu_profiler.timings(RenderPass::POST).write(out, "gpu_post");
+		gpu_profiler.timings(RenderPass::TEXT).write(out, "gpu_text");
+		fprintf(out, "# per frame ");
+		render_system.getRenderStatsTotal().write(out, render_system.getFramesDrawn());
+		fprintf(out, "# ");
+		render_system.getFramePacer().report(out);
+		fprintf(out, "# render scale %.2f\n", render_system.getRenderScale());
+	}
+	if (file != nullptr)
+		fclose(file);
+}
+
 // Entry point
-int main()
+int main(int argc, char* argv[])
 {
+	// --render-thread draws on a dedicated thread so the simulation never waits for vsync
+	bool use_render_thread = false;
+	// --headless renders offscreen without a window and replays a match for a number of frames,
+	// --match <file> replays a recording instead of the scripted match
+	bool headless = false;
+	int headless_frames = 600;
+	int headless_level = 1;
+	const char* match_path = nullptr;
+	const char* stats_path = "benchmark_stats.txt";
+	// --record-match <file> saves the key events of the last match played
+	const char* record_match_path = nullptr;
+	// --gpu-profile <file> logs the GPU time of every render pass of every frame
+	const char* gpu_profile_path = nullptr;
+	// --render-stats <frames> prints the render counters averaged over every that many frames
+	int render_stats_interval = 0;
+	// --pacing vsync|adaptive|uncapped|<fps>, headless runs are uncapped unless told otherwise
+	const char* pacing_arg = nullptr;
+	// --dynamic-resolution <ms> scales the world pass down to keep its GPU time under the budget
+	float dynamic_resolution_ms = 0.f;
+	for (int i = 1; i < argc; i++)
+	{
+		const bool has_value = i + 1 < argc;
+		if (strcmp(argv[i], "--render-thread") == 0)
+			use_render_thread = true;
+		else if (strcmp(argv[i], "--headless") == 0)
+			headless = true;
+		else if (strcmp(argv[i], "--frames") == 0 && has_value)
+			headless_frames = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--level") == 0 && has_value)
+			headless_level = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--match") == 0 && has_value)
+			match_path = argv[++i];
+		else if (strcmp(argv[i], "--stats") == 0 && has_value)
+			stats_path = argv[++i];
+		else if (strcmp(argv[i], "--record-match") == 0 && has_value)
+			record_match_path = argv[++i];
+		else if (strcmp(argv[i], "--gpu-profile") == 0 && has_value)
+			gpu_profile_path = argv[++i];
+		else if (strcmp(argv[i], "--render-stats") == 0 && has_value)
+			render_stats_interval = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--pacing") == 0 && has_value)
+			pacing_arg = argv[++i];
+		else if (strcmp(argv[i], "--dynamic-resolution") == 0 && has_value)
+			dynamic_resolution_ms = (float)atof(argv[++i]);
+	}
+	FramePacing pacing = headless ? FramePacing::UNCAPPED : FramePacing::VSYNC;
+	float pacing_cap_fps = 0.f;
+	if (pacing_arg != nullptr && !FramePacer::parse(pacing_arg, pacing, pacing_cap_fps)) {
+		fprintf(stderr, "Unknown frame pacing %s, expected vsync, adaptive, uncapped or a frame rate\n", pacing_arg);
+		return EXIT_FAILURE;
+	}
+
+	// Offscreen context of a headless run, declared first so it outlives the renderer
+	HeadlessContext headless_context;
+
 	// Global systems
 	GameStateSystem game_state_system;
 	CameraControlSystem cameraControlSystem(&game_state_system);
@@ -48,23 +154,65 @@ int main()
 	InputSystem inputSystem;
 
 
-	// Initializing window
-	GLFWwindow* window = game_state_system.create_window();
-	if (!window) {
-		// Time to read the error message
-		printf("Press any key to exit");
-		getchar();
-		return EXIT_FAILURE;
+	// Initializing window, or the offscreen context of a headless run
+	GLFWwindow* window = nullptr;
+	if (headless) {
+		if (!headless_context.create())
+			return EXIT_FAILURE;
+	} else {
+		window = game_state_system.create_window();
+		if (!window) {
+			// Time to read the error message
+			printf("Press any key to exit");
+			getchar();
+			return EXIT_FAILURE;
+		}
 	}
 
-	// initialize the main systems
+	// initialize the main systems, without an audio device the sounds stay silent
 	sound_system.init_sounds();
-	render_system.init(window);
-	main_menu_system.initialize_main_menu(&render_system, &game_state_system, window);
+	if (!render_system.init(window, headless ? &headless_context : nullptr)) {
+		fprintf(stderr, "Failed to initialize the renderer\n");
+		return EXIT_FAILURE;
+	}
+	if (gpu_profile_path != nullptr)
+		render_system.openGpuProfileLog(gpu_profile_path);
+	render_system.setRenderStatsInterval(render_stats_interval);
+	render_system.setFramePacing(pacing, pacing_cap_fps);
+	if (dynamic_resolution_ms > 0.f) {
+		render_system.dynamic_resolution.enabled = true;
+		render_system.dynamic_resolution.target_gpu_ms = dynamic_resolution_ms;
+	}
 	random_drops_system.init(&game_state_system);
 
-	story_system.init(&render_system, &game_state_system, &sound_system);
-	inputSystem.init(&render_system, &game_state_system, window, &world_system, &main_menu_system, &story_system);
+	MatchRecording match;
+	if (headless) {
+		if (match_path == nullptr)
+			match = MatchRecording::scripted(headless_frames * HEADLESS_FRAME_MS);
+		else if (!match.load(match_path))
+			return EXIT_FAILURE;
+		// Straight into the match, the menus and the story need a window
+		game_state_system.change_level(headless_level);
+		game_state_system.change_game_state(2);
+	} else {
+		main_menu_system.initialize_main_menu(&render_system, &game_state_system, window);
+		story_system.init(&render_system, &game_state_system, &sound_system);
+		inputSystem.init(&render_system, &game_state_system, window, &world_system, &main_menu_system, &story_system);
+		if (record_match_path != nullptr)
+			inputSystem.record_match(&match);
+	}
+
+	// Headless runs tick at the rate of their fixed step, so the match plays out in real time
+	// next to the render thread
+	FramePacer simulation_pacer;
+	if (use_render_thread) {
+		simulation_pacer.configure(FramePacing::CAPPED, headless ? 1000.f / HEADLESS_FRAME_MS : SIMULATION_TICK_HZ);
+		render_system.startRenderThread();
+	}
+
+	FrameTimings frame_times;
+	FrameTimings simulation_times;
+	FrameTimings render_times;
 
 	bool isCameraZooming = false;
 	float cameraZoomTime = 0.0f;
@@ -72,14 +220,19 @@ int main()
 
 	// variable timestep loop
 	auto t = Clock::now();
-	while (!game_state_system.is_over()) {
+	while (headless ? (int)frame_times.samples.size() < headless_frames : !game_state_system.is_over()) {
+		// The benchmark ends with the match
+		if (headless && game_state_system.get_current_state() != 2
+			&& game_state_system.get_current_state() != GameStateSystem::GameState::Winner)
+			break;
+
 		// Processes system messages, if this wasn't present the window would become unresponsive
-		glfwPollEvents();
+		if (!headless)
+			glfwPollEvents();
 
 		// Calculating elapsed times in milliseconds from the previous iteration
 		auto now = Clock::now();
-		float elapsed_ms =
-			(float)(std::chrono::duration_cast<std::chrono::microseconds>(now - t)).count() / 1000;
+		float elapsed_ms = headless ? HEADLESS_FRAME_MS : ms_between(t, now);
 		t = now;
 
 		if (game_state_system.get_current_state() == GameStateSystem::GameState::Winner) {
@@ -101,6 +254,8 @@ int main()
 				world_system.handle_collisions();
 				rocket_system.step(elapsed_ms);
 				if (cameraZoomTime >= zoomDuration) {
+					if (headless)
+						break;
 					cameraControlSystem.reset_camera();
 					createDeathScreen(&render_system, &game_state_system, { window_width_px / 2, window_height_px / 2 }, { window_width_px, window_height_px });
 					game_state_system.set_winner(-1);
@@ -122,8 +277,12 @@ int main()
 			if (game_state_system.is_state_changed) {
 				world_system.init(&render_system, &game_state_system, window, &sound_system, &random_drops_system);
 				game_state_system.is_state_changed = false;
+				match.restart(headless);
 			}
 			if (!world_system.paused) {
+				MatchEvent event;
+				while (headless && match.next(event))
+					world_system.on_key(event.key, event.action, event.mod);
 				movement_system.step(elapsed_ms);
 				out_of_bounds_arrow_system.step();
 				gun_system.step(elapsed_ms);
@@ -136,10 +295,28 @@ int main()
 				player_respawn_system.step();
 				random_drops_system.handleInterpolation(elapsed_ms);
 				rocket_system.step(elapsed_ms);
+				match.clock_ms += elapsed_ms;
 			}
 		}
+		auto simulated = Clock::now();
 		render_system.draw();
+
+		if (headless) {
+			auto rendered = Clock::now();
+			simulation_times.add(ms_between(now, simulated));
+			render_times.add(ms_between(simulated, rendered));
+			frame_times.add(ms_between(now, rendered));
+		}
+		if (use_render_thread)
+			simulation_pacer.endFrame();
 	}
 
+	render_system.stopRenderThread();
+	if (headless)
+		write_benchmark_stats(stats_path, headless_level, frame_times, simulation_times, render_times, render_system);
+	else
+		render_system.getFramePacer().report(stdout);
+	if (record_match_path != nullptr)
+		match.save(record_match_path);
 	return EXIT_SUCCESS;
 }
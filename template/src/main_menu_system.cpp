@@ -10,6 +10,7 @@ void MainMenuSystem::initialize_main_menu(RenderSystem* renderer_arg, GameStateS
     this->game_state_system = game_state_system;
     this->window = window;
     this->renderer = renderer_arg;
+    renderer->requireTextures({ TEXTURE_ASSET_ID::MENUBACKGROUND, TEXTURE_ASSET_ID::LEVELSELECTBACKGROUND });
 
 
     const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
@@ -62,7 +63,8 @@ void MainMenuSystem::create_button(RenderSystem* renderer, const Button& button)
         entity,
         { TEXTURE_ASSET_ID::TEXTURE_COUNT,
           EFFECT_ASSET_ID::COLOURED,
-          GEOMETRY_BUFFER_ID::SQUARE });
+          GEOMETRY_BUFFER_ID::SQUARE,
+          RENDER_LAYER::HUD });
 }
 
 void MainMenuSystem::createMenuBackground(RenderSystem* renderer, const vec2& position, const vec2& size) {
@@ -86,14 +88,16 @@ void MainMenuSystem::createMenuBackground(RenderSystem* renderer, const vec2& po
         entity,
         { TEXTURE_ASSET_ID::MENUBACKGROUND,
           EFFECT_ASSET_ID::BACKGROUND,
-          GEOMETRY_BUFFER_ID::SPRITE });
+          GEOMETRY_BUFFER_ID::SPRITE,
+          RENDER_LAYER::BACKGROUND_BACK });
 	}
 	if (game_state_system->get_current_state() == 1) {
 		registry.renderRequests.insert(
         entity,
         { TEXTURE_ASSET_ID::LEVELSELECTBACKGROUND,
           EFFECT_ASSET_ID::BACKGROUND,
-          GEOMETRY_BUFFER_ID::SPRITE });
+          GEOMETRY_BUFFER_ID::SPRITE,
+          RENDER_LAYER::BACKGROUND_BACK });
 	}
 }
 
@@ -0,0 +1,96 @@
+#include "match_recording.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#include "common.hpp"
+
+bool MatchRecording::load(const std::string& path)
+{
+	std::ifstream stream(path);
+	if (!stream)
+	{
+		fprintf(stderr, "Could not open the match %s\n", path.c_str());
+		return false;
+	}
+	events.clear();
+	MatchEvent event;
+	while (stream >> event.time_ms >> event.key >> event.action >> event.mod)
+		events.push_back(event);
+	std::stable_sort(events.begin(), events.end(),
+		[](const MatchEvent& a, const MatchEvent& b) { return a.time_ms < b.time_ms; });
+	restart(true);
+	return true;
+}
+
+bool MatchRecording::save(const std::string& path) const
+{
+	FILE* file = fopen(path.c_str(), "w");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "Could not write the match %s\n", path.c_str());
+		return false;
+	}
+	for (const MatchEvent& event : events)
+		fprintf(file, "%.3f %d %d %d\n", event.time_ms, event.key, event.action, event.mod);
+	fclose(file);
+	return true;
+}
+
+void MatchRecording::restart(bool keep_events)
+{
+	if (!keep_events)
+		events.clear();
+	clock_ms = 0.f;
+	next_event = 0;
+}
+
+void MatchRecording::record(int key, int action, int mod)
+{
+	// Key repeats carry no new state for the controllers
+	if (action == GLFW_REPEAT)
+		return;
+	events.push_back({ clock_ms, key, action, mod });
+}
+
+bool MatchRecording::next(MatchEvent& event)
+{
+	if (next_event >= events.size() || events[next_event].time_ms > clock_ms)
+		return false;
+	event = events[next_event++];
+	return true;
+}
+
+MatchRecording MatchRecording::scripted(float duration_ms)
+{
+	MatchRecording match;
+	auto press = [&](float time_ms, int key) { match.events.push_back({ time_ms, key, GLFW_PRESS, 0 }); };
+	auto release = [&](float time_ms, int key) { match.events.push_back({ time_ms, key, GLFW_RELEASE, 0 }); };
+
+	// Keybinds of the two players, see WorldSystem::restart_game
+	const int keys[2][4] = {
+		{ GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_W, GLFW_KEY_G },
+		{ GLFW_KEY_LEFT, GLFW_KEY_RIGHT, GLFW_KEY_UP, GLFW_KEY_SEMICOLON },
+	};
+	for (int player = 0; player < 2; player++)
+	{
+		const int left = keys[player][0], right = keys[player][1], up = keys[player][2], fire = keys[player][3];
+		press(0.f, fire);
+		// The players run towards each other first, then turn every 1.5 s, out of phase
+		bool running_left = player == 1;
+		float phase = player * 400.f;
+		for (float time = 0.f; time < duration_ms; time += 1500.f)
+		{
+			const int key = running_left ? left : right;
+			press(time + phase, key);
+			release(time + phase + 1400.f, key);
+			press(time + phase + 700.f, up);
+			release(time + phase + 900.f, up);
+			running_left = !running_left;
+		}
+	}
+	std::stable_sort(match.events.begin(), match.events.end(),
+		[](const MatchEvent& a, const MatchEvent& b) { return a.time_ms < b.time_ms; });
+	return match;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Key events of one match. --record-match <file> records them from a real session and the
+// headless benchmark replays them (--headless --match <file>). Files hold one
+// "time_ms key action mod" line per event, times are simulation ms since the match started.
+struct MatchEvent
+{
+	float time_ms;
+	int key;
+	int action;
+	int mod;
+};
+
+struct MatchRecording
+{
+	std::vector<MatchEvent> events;
+	// Simulation time of the running match, advanced by the game loop while the world steps
+	float clock_ms = 0.f;
+	size_t next_event = 0;
+
+	bool load(const std::string& path);
+	bool save(const std::string& path) const;
+
+	// Rewinds the clock for a new match, a recording in progress starts over
+	void restart(bool keep_events);
+	void record(int key, int action, int mod);
+	// Next event due at the current clock, false when there is none yet
+	bool next(MatchEvent& event);
+
+	// Stand-in match for benchmarks without a recording: both players run back and forth,
+	// jump and keep firing
+	static MatchRecording scripted(float duration_ms);
+};
@@ -1,6 +1,7 @@
 // internal
 #include "movement_system.hpp"
 #include "world_init.hpp"
+#include "fixed_point.hpp"
 
 
 const float JUMP_DELAY_MS = 300.0f;
@@ -61,14 +62,14 @@ void MovementSystem::step(float elapsed_ms)
 			}
 		}
 
-        float step_seconds = elapsed_ms / 1000.f;
+        const phys_scalar dt = to_phys(elapsed_ms / 1000.f);
 
         if (rightKey && (motion_i.velocity.x <= player_i.speed)) {
-			motion_i.velocity.x += player_i.running_force * step_seconds;
+			motion_i.velocity.x = to_float(to_phys(motion_i.velocity.x) + to_phys(player_i.running_force) * dt);
 		}
 
         if (leftKey && (motion_i.velocity.x >= -player_i.speed)) {
-            motion_i.velocity.x -= player_i.running_force * step_seconds;
+            motion_i.velocity.x = to_float(to_phys(motion_i.velocity.x) - to_phys(player_i.running_force) * dt);
         }
 
 
@@ -28,7 +28,8 @@ void OutOfBoundsArrowSystem::step()
 		    entity_i,
             { 	arrow.textureId,
                 EFFECT_ASSET_ID::TEXTURED,
-                GEOMETRY_BUFFER_ID::SPRITE });
+                GEOMETRY_BUFFER_ID::SPRITE,
+                RENDER_LAYER::HUD });
         }
 
         const int offSet = 20;
@@ -1,32 +1,71 @@
 ﻿// internal
 #include "physics_system.hpp"
 #include "world_init.hpp"
+#include "fixed_point.hpp"
 #include <algorithm> // Include the algorithm header
+#include <cstring>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/rotate_vector.hpp>
 #include <vector>
 
+// A resting body whose speed stays below the threshold for this many steps is put to sleep
+const float SLEEP_VELOCITY_THRESHOLD = 1.0f;
+const int SLEEP_STEP_COUNT = 30;
+
+// Upper bound on the sub-steps used to sweep one fast body against one platform
+const int MAX_SWEEP_SUBSTEPS = 64;
+
 // Checks if the two rectangles intersect
 bool collides(const Motion& motion1, const Motion& motion2)
 {
+    const phys_scalar half = to_phys(0.5f);
+
     // Calculate the half width and half height for each rectangle
-    float halfWidth1 = motion1.scale.x / 2.0f;
-    float halfHeight1 = motion1.scale.y / 2.0f;
-    float halfWidth2 = motion2.scale.x / 2.0f;
-    float halfHeight2 = motion2.scale.y / 2.0f;
+    phys_scalar halfWidth1 = to_phys(motion1.scale.x) * half;
+    phys_scalar halfHeight1 = to_phys(motion1.scale.y) * half;
+    phys_scalar halfWidth2 = to_phys(motion2.scale.x) * half;
+    phys_scalar halfHeight2 = to_phys(motion2.scale.y) * half;
 
     // Check for overlap in the x-axis
-    if (abs(motion1.position.x - motion2.position.x) < (halfWidth1 + halfWidth2)) {
+    if (abs(to_phys(motion1.position.x) - to_phys(motion2.position.x)) < (halfWidth1 + halfWidth2)) {
         // Check for overlap in the y-axis
-        if (abs(motion1.position.y - motion2.position.y) < (halfHeight1 + halfHeight2)) {
+        if (abs(to_phys(motion1.position.y) - to_phys(motion2.position.y)) < (halfHeight1 + halfHeight2)) {
             return true; // The rectangles intersect
         }
     }
     return false; // The rectangles don't intersect
 }
 
+// Checks if the moving rectangle touches the other rectangle anywhere on its way from start to end.
+// Slow bodies only test the end position, fast ones are sampled so that no sample moves more than
+// half of the smaller extent of the pair, which keeps them from skipping over thin platforms
+bool sweptCollides(Motion& moving, vec2 start, vec2 end, const Motion& other)
+{
+	vec2 original_position = moving.position;
+
+	float min_extent = min(min(abs(moving.scale.x), abs(moving.scale.y)), min(abs(other.scale.x), abs(other.scale.y)));
+	float displacement = max(abs(end.x - start.x), abs(end.y - start.y));
+
+	int substeps = 1;
+	if (min_extent > 0.f && displacement > min_extent / 2.f)
+		substeps = min((int)ceil(displacement / (min_extent / 2.f)), MAX_SWEEP_SUBSTEPS);
+
+	phys_vec2 phys_start = to_phys(start);
+	phys_vec2 phys_delta = to_phys(end) - phys_start;
+
+	bool hit = false;
+	for (int k = 1; k <= substeps && !hit; k++)
+	{
+		moving.position = to_vec2(phys_start + phys_delta * (to_phys((float)k) / to_phys((float)substeps)));
+		hit = collides(moving, other);
+	}
+
+	moving.position = original_position;
+	return hit;
+}
+
 bool doLineSegmentIntersect(const glm::vec2& p1, const glm::vec2& q1, const glm::vec2& p2, const glm::vec2& q2) {
 	glm::vec2 r = q1 - p1;
 	glm::vec2 s = q2 - p2;
@@ -100,13 +139,16 @@ void PhysicsSystem::checkCollisionBetweenPlayersAndPlatforms(float step_seconds)
     auto& motion_container = registry.motions;
     auto& players_container = registry.players;
     auto& platforms_container = registry.platforms;
+	auto& contacts = registry.playerPlatformContacts;
+
+	contacts.begin_step();
 
     for(uint i = 0; i < players_container.components.size(); i++)
 	{
 		Entity entity_i = players_container.entities[i];
 		Motion& motion_i = motion_container.get(entity_i);
 
-		vec2 predicted_position_i = motion_i.position + (step_seconds * motion_i.velocity);
+		vec2 predicted_position_i = to_vec2(to_phys(motion_i.position) + to_phys(motion_i.velocity) * to_phys(step_seconds));
 		
 		// compare players to all platforms
 		for(uint j = 0; j < platforms_container.components.size(); j++)
@@ -114,23 +156,21 @@ void PhysicsSystem::checkCollisionBetweenPlayersAndPlatforms(float step_seconds)
 			Entity entity_j = platforms_container.entities[j];
 			Motion& motion_j = motion_container.get(entity_j);
 
-			// Temporary update the player position to predicted position
-        	vec2 original_position_i = motion_i.position;
-        
-        	motion_i.position = predicted_position_i;
-
-			if (collides(motion_i, motion_j))
+			// Sweep from the current to the predicted position so fast players can't pass through
+			if (sweptCollides(motion_i, motion_i.position, predicted_position_i, motion_j))
 			{
-				// Create a collisions event
-				// We are abusing the ECS system a bit in that we potentially insert muliple collisions for the same entity
-				registry.playerPlatformCollisions.emplace_with_duplicates(entity_i, entity_j);
-				registry.playerPlatformCollisions.emplace_with_duplicates(entity_j, entity_i);
-			}
+				// Contact wakes up a sleeping platform
+				if (motion_j.is_sleeping)
+					wake(entity_j);
 
-			// Restore the original positions
-			motion_i.position = original_position_i;
+				// Keep the contact alive for this step, the platform only holds players coming from above
+				auto& contact = contacts.touch(entity_i, entity_j);
+				contact.data.collider_active = player_bottoms[i] <= motion_j.position.y - motion_j.scale.y / 2.0f;
+			}
 		}
 	}
+
+	contacts.end_step();
 }
 
 void PhysicsSystem::checkCollisionBetweenPlayersAndPowerups() {
@@ -152,6 +192,9 @@ void PhysicsSystem::checkCollisionBetweenPlayersAndPowerups() {
 
 			if (collides(motion_i, motion_j))
 			{
+				if (motion_j.is_sleeping)
+					wake(entity_j);
+
 				// Create a collisions event
 				// We are abusing the ECS system a bit in that we potentially insert muliple collisions for the same entity
 				registry.playerPowerUpCollisions.emplace_with_duplicates(entity_i, entity_j);
@@ -243,6 +286,9 @@ void PhysicsSystem::checkCollisionBetweenPlayersAndMysteryBoxes() {
 
 			if (collides(motion_i, motion_j))
 			{
+				if (motion_j.is_sleeping)
+					wake(entity_j);
+
 				// Create a collisions event
 				// We are abusing the ECS system a bit in that we potentially insert muliple collisions for the same entity
 				registry.playerMysteryBoxCollisions.emplace_with_duplicates(entity_i, entity_j);
@@ -254,18 +300,148 @@ void PhysicsSystem::checkCollisionBetweenPlayersAndMysteryBoxes() {
 
 
 
+void PhysicsSystem::wake(Entity entity)
+{
+	if (registry.motions.has(entity))
+		registry.motions.get(entity).is_sleeping = false;
+
+	if (registry.restingBodies.has(entity))
+		registry.restingBodies.get(entity).rest_steps = 0;
+}
+
+void PhysicsSystem::resolvePlatformContacts()
+{
+	// Contacts persist across frames, only their transitions change the grounded state
+	for (auto& contact : registry.playerPlatformContacts.contacts) {
+		// The entity and its collider
+		Entity entity = contact.first;
+		Entity entity_other = contact.second;
+
+		if (!registry.players.has(entity)) {
+			continue;
+		}
+
+		Player& curr_player = registry.players.get(entity);
+		bool supporting = false;
+
+		// Player platform contacts that are still touching
+		if (contact.phase != ContactPhase::End && registry.platforms.has(entity_other)) {
+
+			Motion& playerMotion = registry.motions.get(entity);
+			Motion& platformMotion = registry.motions.get(entity_other);
+
+			// Player model intersects the platform
+			if (playerMotion.velocity.y > 0 && contact.data.collider_active) {
+				playerMotion.position.y = platformMotion.position.y - (platformMotion.scale.y / 2.0f) - (playerMotion.scale.y / 2.0f);
+				curr_player.jump_remaining = curr_player.max_jumps;
+				playerMotion.velocity.y = 0;
+				supporting = true;
+			}
+		}
+
+		// The player is grounded as long as at least one contact supports them
+		if (supporting != contact.data.supporting) {
+			contact.data.supporting = supporting;
+			curr_player.ground_contacts += supporting ? 1 : -1;
+			curr_player.is_grounded = curr_player.ground_contacts > 0;
+		}
+	}
+	registry.playerPlatformContacts.erase_ended();
+}
+
+void PhysicsSystem::applyBulletKnockback(Entity player, Entity bullet_entity)
+{
+	Player& hit_player = registry.players.get(player);
+	Motion& playerMotion = registry.motions.get(player);
+	Bullet& bullet = registry.bullets.get(bullet_entity);
+
+	if (bullet.isHitscan) {
+
+		printf("HITSCAN KNOCKBACK: %f\n", bullet.knockback);
+		playerMotion.velocity.x = to_float(to_phys(playerMotion.velocity.x) + to_phys(bullet.knockback));
+
+	} else {
+		Motion& bullet_motion = registry.motions.get(bullet_entity);
+
+		phys_scalar distanceTravelled = abs(to_phys(bullet_motion.position.x) - to_phys(bullet.originalXPosition));
+		phys_scalar direction = to_phys(bullet_motion.velocity.x < 0 ? -1.f : 1.f);
+		phys_scalar resistance = to_phys(hit_player.knockback_resistance);
+		phys_scalar knockback = to_phys(bullet.knockback);
+
+		if (bullet.hasNormalDropOff) {
+			phys_scalar dropOffPenalty = distanceTravelled * to_phys(0.5f) * to_phys(bullet.distanceStrengthModifier);
+
+			if (dropOffPenalty >= knockback) {
+				dropOffPenalty = knockback;
+			}
+
+			phys_scalar knockbackWithDropOff = knockback - dropOffPenalty;
+
+			printf("KNOCKBACK WITH PENALTY: %f\n", to_float(knockbackWithDropOff * resistance));
+
+			playerMotion.velocity.x = to_float(to_phys(playerMotion.velocity.x) + knockbackWithDropOff * direction * resistance);
+		} else {
+			phys_scalar distanceBonus = distanceTravelled * to_phys(bullet.distanceStrengthModifier);
+
+			phys_scalar knockbackWithBonus = knockback + distanceBonus;
+
+			printf("KNOCKBACK WITH BONUS: %f\n", to_float(knockbackWithBonus * resistance));
+
+			playerMotion.velocity.x = to_float(to_phys(playerMotion.velocity.x) + knockbackWithBonus * direction * resistance);
+		}
+	}
+}
+
+void PhysicsSystem::updateRestingBodies()
+{
+	auto& resting_container = registry.restingBodies;
+
+	for (uint i = 0; i < resting_container.size(); i++)
+	{
+		RestingBody& resting_body = resting_container.components[i];
+		Motion& motion = registry.motions.get(resting_container.entities[i]);
+
+		if (motion.is_sleeping)
+			continue;
+
+		if (length(motion.velocity) >= SLEEP_VELOCITY_THRESHOLD) {
+			resting_body.rest_steps = 0;
+			continue;
+		}
+
+		// Body has been at rest long enough, stop simulating it until something wakes it up
+		resting_body.rest_steps++;
+		if (resting_body.rest_steps >= SLEEP_STEP_COUNT) {
+			motion.velocity = { 0.f, 0.f };
+			motion.is_sleeping = true;
+		}
+	}
+}
+
 void PhysicsSystem::step(float elapsed_ms)
 {
 	auto& motion_container = registry.motions;
 	float step_seconds = elapsed_ms / 1000.f;
+	const phys_scalar dt = to_phys(step_seconds);
+
+	// Remember where the players' feet were before they move, one-way platforms need it
+	player_bottoms.clear();
+	for (Entity entity : registry.players.entities)
+	{
+		Motion& motion = motion_container.get(entity);
+		player_bottoms.push_back(motion.position.y + motion.scale.y / 2.0f);
+	}
 
 	// Update positions of all objects based on velocities
 	for(uint i = 0; i < motion_container.size(); i++)
 	{
 		Motion& motion = motion_container.components[i];
-		Entity entity_i = motion_container.entities[i];
 
-		motion.position += step_seconds * motion.velocity;
+		// Sleeping bodies do not move
+		if (motion.is_sleeping)
+			continue;
+
+		motion.position = to_vec2(to_phys(motion.position) + to_phys(motion.velocity) * dt);
 	}
 
 	// Apply friction to all entities with friction component that just stopped moving
@@ -282,28 +458,33 @@ void PhysicsSystem::step(float elapsed_ms)
 		// Get motion component
 		Motion& motion = registry.motions.get(entity_i);
 
-		const float deceleration_force = 3.5;
-		const float ground_friction = 1.5;
+		const phys_scalar deceleration_force = to_phys(3.5f);
+		const phys_scalar ground_friction = to_phys(1.5f);
+		const phys_scalar zero = to_phys(0.0f);
+
+		phys_scalar velocity_x = to_phys(motion.velocity.x);
 
 		// Friction code
-		if (motion.velocity.x != 0.0f) {
+		if (velocity_x != zero) {
 
-			int originalSign = (motion.velocity.x > 0.0f) ? 1 : (motion.velocity.x < 0.0f) ? -1 : 0; // Determine the original direction (+1 or -1)
+			int originalSign = (velocity_x > zero) ? 1 : (velocity_x < zero) ? -1 : 0; // Determine the original direction (+1 or -1)
 
-			if ((abs(motion.velocity.x) > 0.0f)) {
-				motion.velocity.x -= motion.velocity.x * deceleration_force * step_seconds;
+			if ((abs(velocity_x) > zero)) {
+				velocity_x -= velocity_x * deceleration_force * dt;
 			}
 
 			// Only apply if player on ground
-			if (player.is_grounded && (abs(motion.velocity.x) > 0.0f)) {
-				motion.velocity.x -= motion.velocity.x * ground_friction * step_seconds;
+			if (player.is_grounded && (abs(velocity_x) > zero)) {
+				velocity_x -= velocity_x * ground_friction * dt;
 			}
 
 			// Ensure that the velocity doesn't change direction
-			int newSign = (motion.velocity.x > 0.0f) ? 1 : (motion.velocity.x < 0.0f) ? -1 : 0;
-			if (newSign != originalSign && newSign != 0 || abs(motion.velocity.x) < 1) {
-				motion.velocity.x = 0.0f; // Set velocity to zero if it changes direction or it is below 1
+			int newSign = (velocity_x > zero) ? 1 : (velocity_x < zero) ? -1 : 0;
+			if (newSign != originalSign && newSign != 0 || abs(velocity_x) < to_phys(1.0f)) {
+				velocity_x = zero; // Set velocity to zero if it changes direction or it is below 1
 			}
+
+			motion.velocity.x = to_float(velocity_x);
 		}
 
 	}
@@ -321,11 +502,38 @@ void PhysicsSystem::step(float elapsed_ms)
 
 		// apply gravity force onto the motion component of the player
 		Motion& motion = registry.motions.get(entity_i);
-		motion.velocity += vec2(0.0f, gravity.force * step_seconds);
+		if (motion.is_sleeping)
+			continue;
+
+		motion.velocity.y = to_float(to_phys(motion.velocity.y) + to_phys(gravity.force) * dt);
 	}
 
+	updateRestingBodies();
+
 	checkCollisionBetweenPlayersAndPlatforms(step_seconds);
     checkCollisionBetweenPlayersAndPowerups();
     checkCollisionBetweenPlayersAndBullets();
 	checkCollisionBetweenPlayersAndMysteryBoxes();
-}
\ No newline at end of file
+}
+
+uint64_t PhysicsSystem::state_hash()
+{
+	// FNV-1a over the bit patterns of every position and velocity
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](float value) {
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		for (int i = 0; i < 4; i++) {
+			hash ^= (bits >> (i * 8)) & 0xff;
+			hash *= 1099511628211ull;
+		}
+	};
+
+	for (const Motion& motion : registry.motions.components) {
+		mix(motion.position.x);
+		mix(motion.position.y);
+		mix(motion.velocity.x);
+		mix(motion.velocity.y);
+	}
+	return hash;
+}
@@ -16,10 +16,29 @@ void checkCollisionBetweenPlayersAndPowerups();
 void checkCollisionBetweenPlayersAndBullets();
 void checkCollisionBetweenPlayersAndMysteryBoxes();
 bool predictCollisionBetweenPlayerAndBullet(const Mesh* mesh, Motion& motion_i, Motion& motion_j, float timeToCollision);
+void updateRestingBodies();
+
+// Bottom edge of every player before this step's integration, in player container order
+std::vector<float> player_bottoms;
 
 public:
 	void step(float elapsed_ms);
 
+	// Hash of all positions and velocities, two runs fed the same inputs and step times must produce
+	// the same hash on every step when built with DETERMINISTIC_PHYSICS
+	static uint64_t state_hash();
+
+	// Wakes up a sleeping body, call this after applying an impulse to a body that may be asleep
+	static void wake(Entity entity);
+
+	// Lands players on the platforms they touch from above and updates their grounded state,
+	// run once the collision step has updated the player platform contacts. Erases the contacts that ended
+	static void resolvePlatformContacts();
+
+	// Pushes the player away from the bullet that hit them, by the bullet's knockback scaled by the
+	// distance it travelled and the player's knockback resistance
+	static void applyBulletKnockback(Entity player, Entity bullet);
+
 	PhysicsSystem()
 	{
 	}
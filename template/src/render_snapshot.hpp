@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "common.hpp"
+#include "components.hpp"
+#include "tiny_ecs.hpp"
+#include "camera_control_system.hpp"
+
+// What a frame needs besides the components, captured on the simulation thread
+struct RenderFrameState
+{
+	CameraControlSystem::Camera camera;
+	// GLFW only reports the framebuffer size on the main thread
+	ivec2 framebuffer_size = { 0, 0 };
+	float time = 0.f;
+};
+
+// Everything the renderer reads from the simulation, copied at the end of a simulation tick.
+// The render thread draws from its own snapshot while the simulation keeps changing the registry.
+struct RenderSnapshot : RenderFrameState
+{
+	ComponentContainer<RenderRequest> renderRequests;
+	ComponentContainer<Motion> motions;
+	ComponentContainer<vec3> colors;
+	ComponentContainer<Player> players;
+	ComponentContainer<PlayerStatModifier> playerStatModifiers;
+	ComponentContainer<Gun> guns;
+	ComponentContainer<MuzzleFlash> muzzleFlashes;
+	ComponentContainer<AnimatedSprite> animatedSprite;
+	ComponentContainer<ParallaxBackground> parallaxes;
+	ComponentContainer<Text> texts;
+	ComponentContainer<ScreenState> screenStates;
+};
+
+// The components one frame draws, those of a snapshot on the render thread, or the registry's own
+// when the frame is drawn on the simulation thread and nothing changes them in the meantime
+struct RenderFrame : RenderFrameState
+{
+	ComponentContainer<RenderRequest>& renderRequests;
+	ComponentContainer<Motion>& motions;
+	ComponentContainer<vec3>& colors;
+	ComponentContainer<Player>& players;
+	ComponentContainer<PlayerStatModifier>& playerStatModifiers;
+	ComponentContainer<Gun>& guns;
+	ComponentContainer<MuzzleFlash>& muzzleFlashes;
+	ComponentContainer<AnimatedSprite>& animatedSprite;
+	ComponentContainer<ParallaxBackground>& parallaxes;
+	ComponentContainer<Text>& texts;
+	ComponentContainer<ScreenState>& screenStates;
+
+	// Containers is a RenderSnapshot or the ECSRegistry, they name the containers alike
+	template <class Containers>
+	RenderFrame(Containers& containers, const RenderFrameState& state)
+		: RenderFrameState(state),
+		renderRequests(containers.renderRequests),
+		motions(containers.motions),
+		colors(containers.colors),
+		players(containers.players),
+		playerStatModifiers(containers.playerStatModifiers),
+		guns(containers.guns),
+		muzzleFlashes(containers.muzzleFlashes),
+		animatedSprite(containers.animatedSprite),
+		parallaxes(containers.parallaxes),
+		texts(containers.texts),
+		screenStates(containers.screenStates)
+	{
+	}
+};
+
+// Handoff of snapshots from the simulation to the render thread. The simulation fills the back
+// buffer and swaps it with the middle one, the renderer swaps the middle one with its front buffer
+// whenever a newer snapshot is waiting there. The simulation never waits for the renderer, a
+// snapshot the renderer did not get to in time is simply replaced. The renderer sleeps until
+// the next publish when it has drawn everything.
+class SnapshotTripleBuffer
+{
+	static const int INDEX_MASK = 3;
+	static const int FRESH = 4;
+
+	RenderSnapshot buffers[3];
+	std::atomic<int> middle{ 1 };
+	int back = 0;
+	int front = 2;
+	// Only held around the check and the notify, so a publish can't slip in between the
+	// renderer finding nothing new and going to sleep
+	std::mutex wait_mutex;
+	std::condition_variable published;
+
+public:
+	// Simulation side
+	RenderSnapshot& write_buffer() { return buffers[back]; }
+	void publish()
+	{
+		back = middle.exchange(back | FRESH) & INDEX_MASK;
+		wake();
+	}
+
+	// Render side, blocks until something newer than the front buffer was published, or returns
+	// false once quit is set and wake was called
+	bool wait_acquire(const std::atomic<bool>& quit)
+	{
+		{
+			std::unique_lock<std::mutex> lock(wait_mutex);
+			published.wait(lock, [&]() { return quit || (middle.load() & FRESH) != 0; });
+		}
+		if (quit)
+			return false;
+		front = middle.exchange(front) & INDEX_MASK;
+		return true;
+	}
+	RenderSnapshot& read_buffer() { return buffers[front]; }
+
+	// Wakes the renderer to check for a snapshot or the quit flag
+	void wake()
+	{
+		{
+			std::lock_guard<std::mutex> lock(wait_mutex);
+		}
+		published.notify_one();
+	}
+};
@@ -1,16 +1,17 @@
 // internal
 #include "render_system.hpp"
 #include <SDL.h>
+#include <chrono>
+#include <cmath>
 #include <string>
 
 #include "tiny_ecs_registry.hpp"
 #define GLT_IMPLEMENTATION
 #include "../ext/gltext/gltext.h"
 
-void RenderSystem::drawTexturedMesh(Entity entity,
-									const mat3 &projection)
+Transform RenderSystem::getEntityTransform(Entity entity)
 {
-	Motion &motion = registry.motions.get(entity);
+	Motion &motion = frame->motions.get(entity);
 	
 	// Transformation code, see Rendering and Transformation in the template
 	// specification for more info Incrementally updates transformation matrix,
@@ -23,22 +24,22 @@ void RenderSystem::drawTexturedMesh(Entity entity,
 	vec2 flipScale = { -motion.scale.x ,motion.scale.y };
 
 	// flip player
-	if (registry.players.has(entity)) {
-		Player& player = registry.players.get(entity); 
+	if (frame->players.has(entity)) {
+		Player& player = frame->players.get(entity); 
 		
 		transform.scale(player.facing_right ? motion.scale : flipScale);
 	}
-	else if (registry.guns.has(entity)) 
+	else if (frame->guns.has(entity)) 
 	{
-		Gun& gun_i = registry.guns.get(entity);
+		Gun& gun_i = frame->guns.get(entity);
 		Entity owner = gun_i.gunOwner;
-		Player& player = registry.players.get(owner);
+		Player& player = frame->players.get(owner);
 
 		transform.scale(player.facing_right ? motion.scale : flipScale);
 	}
-	else if (registry.muzzleFlashes.has(entity))
+	else if (frame->muzzleFlashes.has(entity))
 	{
-		MuzzleFlash& flash = registry.muzzleFlashes.get(entity);
+		MuzzleFlash& flash = frame->muzzleFlashes.get(entity);
 		transform.scale(flash.facing_right ? motion.scale : flipScale);
 	}
 	else 
@@ -46,54 +47,45 @@ void RenderSystem::drawTexturedMesh(Entity entity,
 		transform.scale(motion.scale);
 	}
 
-	assert(registry.renderRequests.has(entity));
-	const RenderRequest &render_request = registry.renderRequests.get(entity);
+	return transform;
+}
+
+void RenderSystem::drawTexturedMesh(Entity entity,
+									const mat3 &projection)
+{
+	Transform transform = getEntityTransform(entity);
+
+	assert(frame->renderRequests.has(entity));
+	const RenderRequest &render_request = frame->renderRequests.get(entity);
 
 	const GLuint used_effect_enum = (GLuint)render_request.used_effect;
 	assert(used_effect_enum != (GLuint)EFFECT_ASSET_ID::EFFECT_COUNT);
-	const GLuint program = (GLuint)effects[used_effect_enum];
+	const GLuint program = getEffect(render_request.used_effect);
+	const EffectLayout& layout = effect_layouts[used_effect_enum];
 
 	// Setting shaders
-	glUseProgram(program);
+	useProgram(program);
 	gl_has_errors();
 
-	assert(render_request.used_geometry != GEOMETRY_BUFFER_ID::GEOMETRY_COUNT);
-	const GLuint vbo = vertex_buffers[(GLuint)render_request.used_geometry];
-	const GLuint ibo = index_buffers[(GLuint)render_request.used_geometry];
+	// Atlas sprites only have the right texture coordinates in the batched sprite path
+	assert(render_request.used_texture == TEXTURE_ASSET_ID::TEXTURE_COUNT || !texture_in_atlas[(GLuint)render_request.used_texture]);
 
-	// Setting vertex and index buffers
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	// The geometry's vertex array holds its buffers and attribute layout
+	assert(render_request.used_geometry != GEOMETRY_BUFFER_ID::GEOMETRY_COUNT);
+	glBindVertexArray(vertex_arrays[(GLuint)render_request.used_geometry]);
 	gl_has_errors();
 
-	// Input data location as in the vertex buffer
 	if (render_request.used_effect == EFFECT_ASSET_ID::TEXTURED || render_request.used_effect == EFFECT_ASSET_ID::ANIMATED)
 	{
-		GLint in_position_loc = glGetAttribLocation(program, "in_position");
-		GLint in_texcoord_loc = glGetAttribLocation(program, "in_texcoord");
-		gl_has_errors();
-		assert(in_texcoord_loc >= 0);
-
-		glEnableVertexAttribArray(in_position_loc);
-		glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE,
-							  sizeof(TexturedVertex), (void *)0);
-		gl_has_errors();
-
-		glEnableVertexAttribArray(in_texcoord_loc);
-		glVertexAttribPointer(
-			in_texcoord_loc, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex),
-			(void *)sizeof(
-				vec3)); // note the stride to skip the preceeding vertex position
-
 		// Enabling and binding texture to slot 0
 		glActiveTexture(GL_TEXTURE0);
 		gl_has_errors();
 
-		assert(registry.renderRequests.has(entity));
+		assert(frame->renderRequests.has(entity));
 		GLuint texture_id =
-			texture_gl_handles[(GLuint)registry.renderRequests.get(entity).used_texture];
+			texture_gl_handles[(GLuint)frame->renderRequests.get(entity).used_texture];
 
-		glBindTexture(GL_TEXTURE_2D, texture_id);
+		bindTexture(texture_id);
 
 		if (render_request.used_effect == EFFECT_ASSET_ID::ANIMATED) {
 			drawAnimated(entity, EFFECT_ASSET_ID::ANIMATED);
@@ -103,28 +95,10 @@ void RenderSystem::drawTexturedMesh(Entity entity,
 
 	}
 	else if (render_request.used_effect == EFFECT_ASSET_ID::BULLET) {
-		GLint in_position_loc = glGetAttribLocation(program, "in_position");
-		GLint in_color_loc = glGetAttribLocation(program, "in_color");
-		gl_has_errors();
-
-
-
-		glEnableVertexAttribArray(in_position_loc);
-		glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE,
-			sizeof(ColoredVertex), (void*)0);
-
-		glEnableVertexAttribArray(in_color_loc);
-		glVertexAttribPointer(in_color_loc, 3, GL_FLOAT, GL_FALSE,
-			sizeof(ColoredVertex), (void*)sizeof(vec3));
-		gl_has_errors();
-
-		GLint color_uloc = glGetUniformLocation(program, "color");
-		gl_has_errors();
-
 		//painting entity into colours
-		const vec3 entityColor = registry.colors.has(entity) ? registry.colors.get(entity) : vec3(1);
+		const vec3 entityColor = frame->colors.has(entity) ? frame->colors.get(entity) : vec3(1);
 
-		glUniform3fv(color_uloc, 1, (float*)&entityColor);
+		glUniform3fv(layout.color, 1, (float*)&entityColor);
 		gl_has_errors();
 
 		/*if (registry.greenBullet.has(entity)) {
@@ -161,60 +135,34 @@ void RenderSystem::drawTexturedMesh(Entity entity,
 		
 	}
 	else if (render_request.used_effect == EFFECT_ASSET_ID::COLOURED) {
-		GLint in_position_loc = glGetAttribLocation(program, "in_position");
-		gl_has_errors();
-
-		glEnableVertexAttribArray(in_position_loc);
-		glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE,
-							  sizeof(ColoredVertex), (void *)0);
-		gl_has_errors();
-
-		GLint color_uloc = glGetUniformLocation(program, "color");
-    	gl_has_errors();
-
 		//painting entity into colours
-    	const vec3 entityColor = registry.colors.has(entity) ? registry.colors.get(entity) : vec3(1);
+    	const vec3 entityColor = frame->colors.has(entity) ? frame->colors.get(entity) : vec3(1);
 
-    	glUniform3fv(color_uloc, 1, (float*)&entityColor);
+    	glUniform3fv(layout.color, 1, (float*)&entityColor);
 		gl_has_errors();
 	} else if (render_request.used_effect == EFFECT_ASSET_ID::PLAYER){
-		GLint in_position_loc = glGetAttribLocation(program, "in_position");
-		GLint in_texcoord_loc = glGetAttribLocation(program, "in_texcoord");
-		GLint glowColorLocation = glGetUniformLocation(program, "glowColor");
-		GLint glowIntensityLocation = glGetUniformLocation(program, "glowIntensity");
-		GLint playerColor = glGetUniformLocation(program, "chosenPlayerColor");
+		GLint glowColorLocation = layout.glow_color;
+		GLint glowIntensityLocation = layout.glow_intensity;
+		GLint playerColor = layout.player_color;
 
-		gl_has_errors();
-		assert(in_texcoord_loc >= 0);
 		assert(glowColorLocation >= 0); // Ensure the uniform is found
 		assert(glowIntensityLocation >= 0); // Ensure the uniform is found
 
-		glEnableVertexAttribArray(in_position_loc);
-		glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE,
-							  sizeof(TexturedVertex), (void *)0);
-		gl_has_errors();
-
-		glEnableVertexAttribArray(in_texcoord_loc);
-		glVertexAttribPointer(
-			in_texcoord_loc, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex),
-			(void *)sizeof(
-				vec3)); // note the stride to skip the preceeding vertex position
-
 		// Enabling and binding texture to slot 0
 		glActiveTexture(GL_TEXTURE0);
 		gl_has_errors();
 
-		assert(registry.renderRequests.has(entity));
+		assert(frame->renderRequests.has(entity));
 		GLuint texture_id =
-			texture_gl_handles[(GLuint)registry.renderRequests.get(entity).used_texture];
+			texture_gl_handles[(GLuint)frame->renderRequests.get(entity).used_texture];
 
-		glBindTexture(GL_TEXTURE_2D, texture_id);
+		bindTexture(texture_id);
 
 		drawAnimated(entity, EFFECT_ASSET_ID::PLAYER);
 
 		gl_has_errors();
 
-		auto& powerUps = registry.playerStatModifiers.get(entity).powerUpStatModifiers;
+		auto& powerUps = frame->playerStatModifiers.get(entity).powerUpStatModifiers;
 
 		vec3 glowColor = {0.0f, 0.0f, 0.0f};
 		float glowIntensity = 0.0f;
@@ -234,7 +182,7 @@ void RenderSystem::drawTexturedMesh(Entity entity,
 			glowIntensity = 0.8f;
 		}
 
-		vec3 pc = registry.players.get(entity).color;
+		vec3 pc = frame->players.get(entity).color;
 		glUniform3f(playerColor, pc.x, pc.y, pc.z);
 		glUniform3f(glowColorLocation, glowColor.x, glowColor.y, glowColor.z);
     	glUniform1f(glowIntensityLocation, glowIntensity);
@@ -242,34 +190,20 @@ void RenderSystem::drawTexturedMesh(Entity entity,
 		gl_has_errors();
 	}
 	else if (render_request.used_effect == EFFECT_ASSET_ID::BACKGROUND) {
-		GLint in_position_loc = glGetAttribLocation(program, "in_position");
-		GLint in_texcoord_loc = glGetAttribLocation(program, "in_texcoord");
-		GLint uScrollOffset_loc = glGetUniformLocation(program, "uScrollOffset");
-		float backgroundSpeed = registry.parallaxes.get(entity).scrollingSpeed;
+		GLint uScrollOffset_loc = layout.scroll_offset;
+		float backgroundSpeed = frame->parallaxes.get(entity).scrollingSpeed;
 		glUniform1f(uScrollOffset_loc, backgroundSpeed);
 		gl_has_errors();
-		assert(in_texcoord_loc >= 0);
-
-		glEnableVertexAttribArray(in_position_loc);
-		glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE,
-			sizeof(TexturedVertex), (void*)0);
-		gl_has_errors();
-
-		glEnableVertexAttribArray(in_texcoord_loc);
-		glVertexAttribPointer(
-			in_texcoord_loc, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex),
-			(void*)sizeof(
-				vec3)); // note the stride to skip the preceeding vertex position
 
 		// Enabling and binding texture to slot 0
 		glActiveTexture(GL_TEXTURE0);
 		gl_has_errors();
 
-		assert(registry.renderRequests.has(entity));
+		assert(frame->renderRequests.has(entity));
 		GLuint texture_id =
-			texture_gl_handles[(GLuint)registry.renderRequests.get(entity).used_texture];
+			texture_gl_handles[(GLuint)frame->renderRequests.get(entity).used_texture];
 
-		glBindTexture(GL_TEXTURE_2D, texture_id);
+		bindTexture(texture_id);
 		gl_has_errors();
 	}
 	else
@@ -277,45 +211,258 @@ void RenderSystem::drawTexturedMesh(Entity entity,
 		assert(false && "Type of render request not supported");
 	}
 
-	// Getting uniform locations for glUniform* calls
-	GLint color_uloc = glGetUniformLocation(program, "fcolor");
-	const vec3 color = registry.colors.has(entity) ? registry.colors.get(entity) : vec3(1);
-	glUniform3fv(color_uloc, 1, (float *)&color);
-	gl_has_errors();
-
-	// Get number of indices from index buffer, which has elements uint16_t
-	GLint size = 0;
-	glGetBufferParameteriv(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+	// Uniform locations come from the effect's layout table
+	const vec3 color = frame->colors.has(entity) ? frame->colors.get(entity) : vec3(1);
+	glUniform3fv(layout.fcolor, 1, (float *)&color);
 	gl_has_errors();
 
-	GLsizei num_indices = size / sizeof(uint16_t);
+	// Number of indices was recorded when the geometry was uploaded
+	GLsizei num_indices = index_counts[(GLuint)render_request.used_geometry];
 	// GLsizei num_triangles = num_indices / 3;
 
-	GLint currProgram;
-	glGetIntegerv(GL_CURRENT_PROGRAM, &currProgram);
 	// Setting uniform values to the currently bound program
-	GLuint transform_loc = glGetUniformLocation(currProgram, "transform");
-	glUniformMatrix3fv(transform_loc, 1, GL_FALSE, (float *)&transform.mat);
-	GLuint projection_loc = glGetUniformLocation(currProgram, "projection");
-	glUniformMatrix3fv(projection_loc, 1, GL_FALSE, (float *)&projection);
+	glUniformMatrix3fv(layout.transform, 1, GL_FALSE, (float *)&transform.mat);
+	glUniformMatrix3fv(layout.projection, 1, GL_FALSE, (float *)&projection);
 	gl_has_errors();
 	// Drawing of num_indices/3 triangles specified in the index buffer
 	glDrawElements(GL_TRIANGLES, num_indices, GL_UNSIGNED_SHORT, nullptr);
+	countDraw(num_indices);
 	gl_has_errors();
 }
 
-// draw the intermediate texture to the screen, with some distortion to simulate
-// water
-void RenderSystem::drawToScreen()
+bool RenderSystem::isBatchedSprite(const RenderRequest& render_request)
+{
+	return (render_request.used_effect == EFFECT_ASSET_ID::TEXTURED && render_request.used_geometry == GEOMETRY_BUFFER_ID::SPRITE) ||
+		(render_request.used_effect == EFFECT_ASSET_ID::ANIMATED && render_request.used_geometry == GEOMETRY_BUFFER_ID::ANIMATED_SPRITE);
+}
+
+void RenderSystem::addSpriteInstance(Entity entity, const RenderRequest& render_request, const mat3& projection)
+{
+	// A new GL texture starts a new batch, drawing order is kept. Sprites in the atlas share one.
+	const GLuint texture_id = texture_gl_handles[(GLuint)render_request.used_texture];
+	if (texture_id != sprite_batch_texture)
+	{
+		flushSpriteBatch(projection);
+		sprite_batch_texture = texture_id;
+	}
+
+	Transform transform = getEntityTransform(entity);
+	const vec3 color = frame->colors.has(entity) ? frame->colors.get(entity) : vec3(1);
+
+	SpriteInstance instance;
+	instance.transform[0] = transform.mat[0];
+	instance.transform[1] = transform.mat[1];
+	instance.transform[2] = transform.mat[2];
+	instance.color = vec4(color, 0.f);
+
+	// Region of the sprite inside its GL texture, only smaller than the texture for atlas sprites
+	vec4 uv_rect = texture_uv_rects[(GLuint)render_request.used_texture];
+	instance.uv_rect = uv_rect;
+
+	// Animated sprites pick their frame out of the sprite sheet, see the ANIMATED_SPRITE geometry
+	if (render_request.used_effect == EFFECT_ASSET_ID::ANIMATED)
+	{
+		AnimatedSprite& animated_sprite = frame->animatedSprite.get(entity);
+		vec2 frame_offset = { animated_sprite.sprite_width * animated_sprite.animation_frame,
+			animated_sprite.sprite_height * animated_sprite.animation_type };
+		vec2 frame_size = { 0.125f, 0.25f };
+		instance.uv_rect = {
+			uv_rect.x + frame_offset.x * uv_rect.z, uv_rect.y + frame_offset.y * uv_rect.w,
+			frame_size.x * uv_rect.z, frame_size.y * uv_rect.w };
+		instance.color.a = 1.f;
+	}
+
+	sprite_instances.push_back(instance);
+}
+
+void RenderSystem::flushSpriteBatch(const mat3& projection)
+{
+	if (sprite_instances.empty())
+		return;
+
+	useProgram(effects[(GLuint)EFFECT_ASSET_ID::SPRITE_BATCH]);
+	const EffectLayout& layout = effect_layouts[(GLuint)EFFECT_ASSET_ID::SPRITE_BATCH];
+	glUniformMatrix3fv(layout.projection, 1, GL_FALSE, (float *)&projection);
+	gl_has_errors();
+
+	glActiveTexture(GL_TEXTURE0);
+	bindTexture(sprite_batch_texture);
+	gl_has_errors();
+
+	// Orphan and refill the instance buffer every batch
+	glBindVertexArray(sprite_batch_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, sprite_instance_vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(SpriteInstance) * sprite_instances.size(), sprite_instances.data(), GL_STREAM_DRAW);
+	render_stats.upload_bytes += sizeof(SpriteInstance) * sprite_instances.size();
+	gl_has_errors();
+
+	glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, nullptr, (GLsizei)sprite_instances.size());
+	countDraw(6, (GLsizei)sprite_instances.size());
+	gl_has_errors();
+
+	sprite_instances.clear();
+	sprite_batch_texture = 0;
+}
+
+void RenderSystem::countDraw(GLsizei indices, GLsizei instances)
+{
+	render_stats.draw_calls++;
+	render_stats.triangles += (uint64_t)(indices / 3) * instances;
+}
+
+void RenderSystem::useProgram(GLuint program)
+{
+	if (program == bound_program)
+	{
+		render_stats.program_binds_skipped++;
+		return;
+	}
+	glUseProgram(program);
+	bound_program = program;
+	render_stats.program_binds++;
+}
+
+void RenderSystem::bindTexture(GLuint texture)
+{
+	if (texture == bound_texture)
+	{
+		render_stats.texture_binds_skipped++;
+		return;
+	}
+	glBindTexture(GL_TEXTURE_2D, texture);
+	bound_texture = texture;
+	render_stats.texture_binds++;
+}
+
+uint64_t RenderSystem::makeSortKey(Entity entity, const RenderRequest& render_request)
+{
+	// Atlas sprites all share one texture key so they stay in one batch
+	uint64_t texture_key = (uint64_t)render_request.used_texture;
+	if (render_request.used_texture != TEXTURE_ASSET_ID::TEXTURE_COUNT && texture_in_atlas[(int)render_request.used_texture])
+		texture_key = (uint64_t)TEXTURE_ASSET_ID::TEXTURE_COUNT + 1;
+
+	// Entities are created in drawing order, so the entity id breaks ties within a material
+	return ((uint64_t)render_request.layer << 60) |
+		((uint64_t)render_request.used_effect << 56) |
+		(texture_key << 48) |
+		((uint64_t)render_request.used_geometry << 44) |
+		(uint64_t)(unsigned int)entity;
+}
+
+void RenderSystem::buildRenderQueue()
+{
+	static_assert((int)RENDER_LAYER::LAYER_COUNT <= 16, "layer must fit in 4 bits of the sort key");
+	static_assert(effect_count <= 16, "effect must fit in 4 bits of the sort key");
+	static_assert(texture_count + 2 <= 256, "texture must fit in 8 bits of the sort key");
+	static_assert(geometry_count <= 16, "geometry must fit in 4 bits of the sort key");
+
+	// Only entities that overlap the camera rectangle are drawn
+	const vec4 camera_rect = getCameraRect();
+
+	render_queue.clear();
+	for (uint i = 0; i < frame->renderRequests.size(); i++)
+	{
+		Entity entity = frame->renderRequests.entities[i];
+		if (!frame->motions.has(entity))
+			continue;
+
+		// Half the diagonal covers the sprite at any rotation
+		const Motion& motion = frame->motions.get(entity);
+		const float radius = 0.5f * length(motion.scale);
+		if (motion.position.x + radius < camera_rect.x || motion.position.x - radius > camera_rect.z ||
+			motion.position.y + radius < camera_rect.y || motion.position.y - radius > camera_rect.w)
+		{
+			render_stats.culled++;
+			continue;
+		}
+
+		render_queue.push_back({ makeSortKey(entity, frame->renderRequests.components[i]), entity });
+	}
+
+	// LSD radix sort, one byte per pass. Passes where every key has the same byte are skipped.
+	// Copied rather than resized, default constructing an Entity allocates a new id
+	render_queue_scratch = render_queue;
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		size_t counts[257] = {};
+		for (const RenderItem& item : render_queue)
+			counts[((item.key >> shift) & 0xff) + 1]++;
+		if (!render_queue.empty() && counts[((render_queue[0].key >> shift) & 0xff) + 1] == render_queue.size())
+			continue;
+
+		for (int digit = 0; digit < 256; digit++)
+			counts[digit + 1] += counts[digit];
+		for (const RenderItem& item : render_queue)
+			render_queue_scratch[counts[(item.key >> shift) & 0xff]++] = item;
+		render_queue.swap(render_queue_scratch);
+	}
+}
+
+void RenderSystem::updateRenderScale()
+{
+	if (!dynamic_resolution.enabled)
+	{
+		render_scale = 1.f;
+		return;
+	}
+
+	// Both passes scale with the world's pixel count, the text pass does not
+	const float world_ms = gpu_profiler.latest(RenderPass::WORLD);
+	if (world_ms < 0.f)
+		return;
+	const float gpu_ms = world_ms + max(gpu_profiler.latest(RenderPass::POST), 0.f);
+
+	// Results come back QUERY_FRAMES frames late, the first ones after a change still show the old scale
+	if (++frames_since_rescale <= GpuProfiler::QUERY_FRAMES)
+		return;
+	scaled_gpu_ms = scaled_gpu_samples == 0 ? gpu_ms : scaled_gpu_ms * 0.9f + gpu_ms * 0.1f;
+	if (++scaled_gpu_samples < 15)
+		return;
+
+	// Fill cost follows the pixel count, i.e. the square of the scale. Over budget the scale
+	// drops to where the budget should be met, well under it the scale creeps back up.
+	const DynamicResolutionSettings& settings = dynamic_resolution;
+	float scale = render_scale;
+	if (scaled_gpu_ms > settings.target_gpu_ms)
+		scale = render_scale * max(sqrtf(settings.target_gpu_ms / scaled_gpu_ms), 0.75f);
+	else if (scaled_gpu_ms < settings.target_gpu_ms * 0.7f)
+		scale = render_scale + 0.05f;
+	scale = min(max(scale, settings.min_scale), settings.max_scale);
+
+	if (fabsf(scale - render_scale) < 0.01f)
+		return;
+	printf("Render scale %.2f -> %.2f (GPU %.2f ms, target %.2f ms)\n",
+		render_scale, scale, scaled_gpu_ms, settings.target_gpu_ms);
+	render_scale = scale;
+	frames_since_rescale = 0;
+	scaled_gpu_samples = 0;
+}
+
+int RenderSystem::activePostEffects()
+{
+	int post_effects = 0;
+	if (post_process.distortion)
+		post_effects |= POST_EFFECT_DISTORTION;
+	if (post_process.color_shift)
+		post_effects |= POST_EFFECT_COLOR_SHIFT;
+	if (frame->screenStates.get(screen_state_entity).screen_darken_factor > 0)
+		post_effects |= POST_EFFECT_FADE;
+	return post_effects;
+}
+
+// draw the intermediate texture to the screen through the post processing uber pass,
+// upscaling the part of it a scaled world pass covered
+void RenderSystem::drawToScreen(int post_effects, vec2 scale)
 {
 	// Setting shaders
 	// get the water texture, sprite mesh, and program
 	glUseProgram(effects[(GLuint)EFFECT_ASSET_ID::WATER]);
+	render_stats.program_binds++;
 	gl_has_errors();
 	// Clearing backbuffer
-	int w, h;
-	glfwGetFramebufferSize(window, &w, &h); // Note, this will be 2x the resolution given to glfwCreateWindow on retina displays
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	const int w = frame->framebuffer_size.x; // Note, this will be 2x the resolution given to glfwCreateWindow on retina displays
+	const int h = frame->framebuffer_size.y;
+	glBindFramebuffer(GL_FRAMEBUFFER, screen_framebuffer);
 	glViewport(0, 0, w, h);
 	glDepthRange(0, 10);
 	glClearColor(1.f, 0, 0, 1.0);
@@ -328,64 +475,150 @@ void RenderSystem::drawToScreen()
 	glDisable(GL_DEPTH_TEST);
 
 	// Draw the screen texture on the quad geometry
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[(GLuint)GEOMETRY_BUFFER_ID::SCREEN_TRIANGLE]);
-	glBindBuffer(
-		GL_ELEMENT_ARRAY_BUFFER,
-		index_buffers[(GLuint)GEOMETRY_BUFFER_ID::SCREEN_TRIANGLE]); // Note, GL_ELEMENT_ARRAY_BUFFER associates
-																	 // indices to the bound GL_ARRAY_BUFFER
+	glBindVertexArray(vertex_arrays[(GLuint)GEOMETRY_BUFFER_ID::SCREEN_TRIANGLE]);
 	gl_has_errors();
-	const GLuint water_program = effects[(GLuint)EFFECT_ASSET_ID::WATER];
+	const EffectLayout& water_layout = effect_layouts[(GLuint)EFFECT_ASSET_ID::WATER];
 	// Set clock
-	GLuint time_uloc = glGetUniformLocation(water_program, "time");
-	GLuint dead_timer_uloc = glGetUniformLocation(water_program, "screen_darken_factor");
-	glUniform1f(time_uloc, (float)(glfwGetTime() * 10.0f));
-	ScreenState &screen = registry.screenStates.get(screen_state_entity);
-	glUniform1f(dead_timer_uloc, screen.screen_darken_factor);
-	gl_has_errors();
-	// Set the vertex position and vertex texture coordinates (both stored in the
-	// same VBO)
-	GLint in_position_loc = glGetAttribLocation(water_program, "in_position");
-	glEnableVertexAttribArray(in_position_loc);
-	glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void *)0);
+	glUniform1f(water_layout.time, frame->time * 10.0f);
+	ScreenState &screen = frame->screenStates.get(screen_state_entity);
+	glUniform1f(water_layout.screen_darken_factor, screen.screen_darken_factor);
+	glUniform1i(water_layout.post_effects, post_effects);
+	glUniform2f(water_layout.render_scale, scale.x, scale.y);
 	gl_has_errors();
-
 	// Bind our texture in Texture Unit 0
 	glActiveTexture(GL_TEXTURE0);
 
 	glBindTexture(GL_TEXTURE_2D, off_screen_render_buffer_color);
+	render_stats.texture_binds++;
 	gl_has_errors();
 	// Draw
 	glDrawElements(
 		GL_TRIANGLES, 3, GL_UNSIGNED_SHORT,
 		nullptr); // one triangle = 3 vertices; nullptr indicates that there is
 				  // no offset from the bound index buffer
+	countDraw(3);
 	gl_has_errors();
 }
 
 void RenderSystem::drawAnimated(Entity entity, EFFECT_ASSET_ID asset_id) {
-	AnimatedSprite& animated_sprite = registry.animatedSprite.get(entity);
-	GLuint textured_animation_program = effects[(GLuint)asset_id];
-	glUseProgram(textured_animation_program);
+	AnimatedSprite& animated_sprite = frame->animatedSprite.get(entity);
+	const EffectLayout& layout = effect_layouts[(GLuint)asset_id];
 
-	GLint frame_height_uloc = glGetUniformLocation(textured_animation_program, "sprite_height");
-	glUniform1f(frame_height_uloc, animated_sprite.sprite_height);
-	GLint frame_width_uloc = glGetUniformLocation(textured_animation_program, "sprite_width");
-	glUniform1f(frame_width_uloc, animated_sprite.sprite_width);
+	glUniform1f(layout.sprite_height, animated_sprite.sprite_height);
+	glUniform1f(layout.sprite_width, animated_sprite.sprite_width);
+	glUniform1f(layout.animation_frame, (float)animated_sprite.animation_frame);
+	glUniform1f(layout.animation_type, (float)animated_sprite.animation_type);
 
-	GLint animation_frame_uloc = glGetUniformLocation(textured_animation_program, "animation_frame");
-	glUniform1f(animation_frame_uloc, (float)animated_sprite.animation_frame);
+	gl_has_errors();
+}
 
-	GLint animation_type_uloc = glGetUniformLocation(textured_animation_program, "animation_type");
-	glUniform1f(animation_type_uloc, (float)animated_sprite.animation_type);
+void RenderSystem::buildTextGlyphs(CachedText& cached)
+{
+	// Same layout as glText: glyphs sit side by side, lines are one glyph height apart.
+	// Positions are in font pixels with the text's top left corner at the origin.
+	cached.glyphs.clear();
+	cached.width = 0.f;
+	cached.height = (float)_gltFontGlyphHeight;
+
+	float glyph_x = 0.f;
+	float glyph_y = 0.f;
+	const float glyph_height = (float)_gltFontGlyphHeight;
+	for (char c : cached.string)
+	{
+		if (c == '\n')
+		{
+			glyph_x = 0.f;
+			glyph_y += glyph_height;
+			cached.height += glyph_height;
+			continue;
+		}
+		else if (c == '\r')
+		{
+			glyph_x = 0.f;
+			continue;
+		}
+		if (!gltIsCharacterSupported(c))
+			continue;
 
-	gl_has_errors();
+		const _GLTglyph& glyph = _gltFontGlyphs2[c - _gltFontGlyphMinChar];
+		const float glyph_width = (float)glyph.w;
+		if (glyph.drawable)
+			cached.glyphs.push_back({ glyph_x, glyph_y, glyph_width, glyph.u1, glyph.v1, glyph.u2, glyph.v2 });
+
+		glyph_x += glyph_width;
+		cached.width = max(cached.width, glyph_x);
+	}
 }
 
-void RenderSystem::drawText(int viewportWidth, int viewportHeight) {
+void RenderSystem::appendTextVertices(const CachedText& cached, const Text& text, vec2 viewport_scale, float scaling_factor) {
+	if (cached.glyphs.empty())
+		return;
+
+	const float scale = text.scale * scaling_factor;
+	float x = text.position.x * viewport_scale.x;
+	float y = text.position.y * viewport_scale.y;
+
+	if (text.horizontalAlignment == GLT_CENTER)
+		x -= cached.width * scale * 0.5f;
+	else if (text.horizontalAlignment == GLT_RIGHT)
+		x -= cached.width * scale;
+
+	if (text.verticalAlignment == GLT_CENTER)
+		y -= cached.height * scale * 0.5f;
+	else if (text.verticalAlignment == GLT_BOTTOM)
+		y -= cached.height * scale;
+
+	const vec4 color = { text.color, text.opacity };
+	const float glyph_height = (float)_gltFontGlyphHeight * scale;
+	for (const CachedText::Glyph& glyph : cached.glyphs) {
+		const float left = x + glyph.x * scale;
+		const float top = y + glyph.y * scale;
+		const float right = left + glyph.width * scale;
+		const float bottom = top + glyph_height;
+
+		text_vertices.push_back({ { left, top }, { glyph.u1, glyph.v1 }, color });
+		text_vertices.push_back({ { right, bottom }, { glyph.u2, glyph.v2 }, color });
+		text_vertices.push_back({ { right, top }, { glyph.u2, glyph.v1 }, color });
+		text_vertices.push_back({ { left, top }, { glyph.u1, glyph.v1 }, color });
+		text_vertices.push_back({ { left, bottom }, { glyph.u1, glyph.v2 }, color });
+		text_vertices.push_back({ { right, bottom }, { glyph.u2, glyph.v2 }, color });
+	}
+}
+
+void RenderSystem::appendGpuOverlay(vec2 viewport_scale, float scaling_factor) {
+	static const char* pass_names[render_pass_count] = { "world", "post", "text" };
+
+	std::vector<std::string> lines;
+	char line[128];
+	for (int pass = 0; pass < render_pass_count; pass++) {
+		const FrameTimings& timings = gpu_profiler.timings((RenderPass)pass);
+		snprintf(line, sizeof(line), "gpu %-5s %6.2f ms  p95 %6.2f  max %6.2f", pass_names[pass],
+			timings.mean(), timings.percentile(95.f), timings.max());
+		lines.push_back(line);
+	}
 
-	//printf("INIT TEXT RENDER VALUE %d", initTextRender);
+	// Left and top aligned in the corner, one font height apart
+	overlay_text.resize(lines.size());
+	Text text;
+	text.color = { 1.f, 1.f, 1.f };
+	text.scale = 2.f;
+	text.horizontalAlignment = GLT_LEFT;
+	text.verticalAlignment = GLT_TOP;
+	for (size_t i = 0; i < lines.size(); i++) {
+		CachedText& cached = overlay_text[i];
+		if (cached.string != lines[i] || !cached.built) {
+			cached.string = lines[i];
+			buildTextGlyphs(cached);
+			cached.built = true;
+		}
+		text.position = { 10.f, 10.f + i * (float)_gltFontGlyphHeight * text.scale * scaling_factor / viewport_scale.y };
+		appendTextVertices(cached, text, viewport_scale, scaling_factor);
+	}
+}
 
-	// Initialize glText
+void RenderSystem::drawText(int viewportWidth, int viewportHeight) {
+
+	// Initialize glText, only its font texture and glyph table are used
 	if (!initTextRender) {
 		if (!gltInit()) {
 			fprintf(stderr, "Failed to initialize glText\n");
@@ -394,35 +627,69 @@ void RenderSystem::drawText(int viewportWidth, int viewportHeight) {
 		initTextRender = true;
 	}
 
-    // Create a text object and set its text
 	float widthScale = (float) viewportWidth / (float) window_width_px;
 	float heightScale = (float) viewportHeight / (float) window_height_px;
 
 	float scalingFactor = (float) viewportWidth / 2560.0f;
 
+	// Append the glyph quads of every text into one vertex stream
+	text_vertices.clear();
+	for (int i = 0; i < frame->texts.size(); i++) {
+		Text& text_i = frame->texts.components[i];
+
+		// Every text entity keeps its glyph layout, it is only rebuilt when the string changes.
+		// Position, scale and alignment are applied while appending.
+		CachedText& cached = text_cache[(unsigned int)frame->texts.entities[i]];
+		if (cached.string != text_i.string || !cached.built) {
+			cached.string = text_i.string;
+			buildTextGlyphs(cached);
+			cached.built = true;
+		}
+		cached.used = true;
+
+		appendTextVertices(cached, text_i, { widthScale, heightScale }, scalingFactor);
+	}
+	if (show_gpu_overlay)
+		appendGpuOverlay({ widthScale, heightScale }, scalingFactor);
+
+	// Forget the layouts of text entities that are gone
+	for (auto it = text_cache.begin(); it != text_cache.end();) {
+		if (!it->second.used) {
+			it = text_cache.erase(it);
+			continue;
+		}
+		it->second.used = false;
+		it++;
+	}
+
+	if (text_vertices.empty())
+		return;
+
+	// All text is drawn with one call from the glText font texture
 	glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    // Disable depth testing
-    // glDisable(GL_DEPTH_TEST);
-
-    // Begin text drawing (this sets up the necessary OpenGL state and shaders)
-	GLTtext* text = gltCreateText();
-    gltBeginDraw();
+	const EffectLayout& layout = effect_layouts[(GLuint)EFFECT_ASSET_ID::TEXT];
+	glUseProgram(effects[(GLuint)EFFECT_ASSET_ID::TEXT]);
+	render_stats.program_binds++;
 
-	for (int i = 0; i < registry.texts.size(); i++) {
-		Text& text_i = registry.texts.components[i];
+	// Framebuffer pixels, y down, to clip space
+	const mat3 projection = { { 2.f / viewportWidth, 0.f, 0.f }, { 0.f, -2.f / viewportHeight, 0.f }, { -1.f, 1.f, 1.f } };
+	glUniformMatrix3fv(layout.projection, 1, GL_FALSE, (float*)&projection);
 
-		gltSetText(text, text_i.string.c_str());
-		gltColor(text_i.color.x, text_i.color.y, text_i.color.z, text_i.opacity);
-    	gltDrawText2DAligned(text, text_i.position.x * widthScale, text_i.position.y * heightScale, text_i.scale * scalingFactor, text_i.horizontalAlignment, text_i.verticalAlignment);
-	}
-    // End text drawing (restores OpenGL state)
-    gltEndDraw();
-	gltDeleteText(text);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, _gltText2DFontTexture);
+	render_stats.texture_binds++;
+
+	glBindVertexArray(text_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, text_vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(TextVertex) * text_vertices.size(), text_vertices.data(), GL_STREAM_DRAW);
+	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)text_vertices.size());
+	render_stats.upload_bytes += sizeof(TextVertex) * text_vertices.size();
+	render_stats.text_glyphs += text_vertices.size() / 6;
+	countDraw((GLsizei)text_vertices.size());
+	gl_has_errors();
 
-	// Restore depth test state if other parts of your rendering use it
-    //glEnable(GL_DEPTH_TEST);
     glDisable(GL_BLEND);
 
 	glBindVertexArray(vao_rebind);
@@ -435,19 +702,128 @@ void RenderSystem::drawText(int viewportWidth, int viewportHeight) {
 // http://www.opengl-tutorial.org/intermediate-tutorials/tutorial-14-render-to-texture/
 void RenderSystem::draw()
 {
-	// Getting size of window
-	int w, h;
-	glfwGetFramebufferSize(window, &w, &h); // Note, this will be 2x the resolution given to glfwCreateWindow on retina displays
+	// Without a render thread the registry stays still until the frame is drawn, no need for a copy
+	if (!render_thread.joinable())
+	{
+		RenderFrame live(registry, captureFrameState());
+		frame = &live;
+		drawFrame();
+		frame = nullptr;
+		return;
+	}
 
-	// First render to the custom framebuffer
-	glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
+	captureSnapshot(snapshots.write_buffer());
+	snapshots.publish();
+}
+
+RenderFrameState RenderSystem::captureFrameState()
+{
+	RenderFrameState state;
+	state.camera = camera_control_system->get_camera();
+	state.framebuffer_size = getFramebufferSize();
+	if (window)
+		state.time = (float)glfwGetTime();
+	else
+		state.time = std::chrono::duration<float>(std::chrono::steady_clock::now() - headless_start).count();
+	return state;
+}
+
+void RenderSystem::captureSnapshot(RenderSnapshot& snapshot)
+{
+	snapshot.renderRequests = registry.renderRequests;
+	snapshot.motions = registry.motions;
+	snapshot.colors = registry.colors;
+	snapshot.players = registry.players;
+	snapshot.playerStatModifiers = registry.playerStatModifiers;
+	snapshot.guns = registry.guns;
+	snapshot.muzzleFlashes = registry.muzzleFlashes;
+	snapshot.animatedSprite = registry.animatedSprite;
+	snapshot.parallaxes = registry.parallaxes;
+	snapshot.texts = registry.texts;
+	snapshot.screenStates = registry.screenStates;
+	static_cast<RenderFrameState&>(snapshot) = captureFrameState();
+}
+
+void RenderSystem::makeContextCurrent(bool current)
+{
+	if (window)
+		glfwMakeContextCurrent(current ? window : nullptr);
+	else if (headless_context)
+		headless_context->makeCurrent(current);
+}
+
+void RenderSystem::startRenderThread()
+{
+	if (!window && !headless_context)
+		return;
+	// The context can only be current on one thread at a time
+	makeContextCurrent(false);
+	render_thread_quit = false;
+	render_thread = std::thread(&RenderSystem::renderThreadLoop, this);
+}
+
+void RenderSystem::stopRenderThread()
+{
+	if (!render_thread.joinable())
+		return;
+	render_thread_quit = true;
+	snapshots.wake();
+	render_thread.join();
+	makeContextCurrent(true);
+}
+
+void RenderSystem::renderThreadLoop()
+{
+	makeContextCurrent(true);
+	// Only snapshots that were not drawn yet, the simulation is free to publish
+	// several while a frame waits for vsync
+	while (snapshots.wait_acquire(render_thread_quit))
+	{
+		RenderFrame snapshot(snapshots.read_buffer(), snapshots.read_buffer());
+		frame = &snapshot;
+		drawFrame();
+		frame = nullptr;
+	}
+	makeContextCurrent(false);
+}
+
+void RenderSystem::drawFrame()
+{
+	// Getting size of window
+	const int w = frame->framebuffer_size.x; // Note, this will be 2x the resolution given to glfwCreateWindow on retina displays
+	const int h = frame->framebuffer_size.y;
+
+	const int post_effects = activePostEffects();
+
+	// Draw all visible textured meshes that have a position and size component, in sort key order
+	render_stats = RenderStats();
+	buildRenderQueue();
+	render_stats.submitted = (int)render_queue.size();
+	// Before the world pass, so texture uploads are not timed as drawing
+	updateTextureResidency();
+
+	gpu_profiler.beginFrame();
+	updateRenderScale();
+	const ivec2 world_size = {
+		max(1, (int)(w * render_scale + 0.5f)),
+		max(1, (int)(h * render_scale + 0.5f)) };
+	const bool scaled = world_size.x != w || world_size.y != h;
+
+	// Render to the custom framebuffer only when the screen pass has something to do,
+	// otherwise straight to the window to save a full screen write and read
+	const bool screen_pass = post_effects != 0 || scaled;
+	glBindFramebuffer(GL_FRAMEBUFFER, screen_pass ? frame_buffer : screen_framebuffer);
+	gpu_profiler.begin(RenderPass::WORLD);
 	gl_has_errors();
-	// Clearing backbuffer
-	glViewport(0, 0, w, h);
+	// Clearing backbuffer, only the part a scaled world covers
+	glViewport(0, 0, world_size.x, world_size.y);
 	glDepthRange(0.00001, 10);
 	glClearColor(0, 0, 1, 1.0);
 	glClearDepth(10.f);
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(0, 0, world_size.x, world_size.y);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glDisable(GL_SCISSOR_TEST);
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glDisable(GL_DEPTH_TEST); // native OpenGL does not work with a depth buffer
@@ -455,34 +831,71 @@ void RenderSystem::draw()
 							  // sprites back to front
 	gl_has_errors();
 	mat3 projection_2D = createProjectionMatrix();
-	// Draw all textured meshes that have a position and size component
-	for (Entity entity : registry.renderRequests.entities)
+
+	// Nothing is known to be bound at the start of the pass
+	bound_program = 0;
+	bound_texture = 0;
+
+	for (RenderItem& item : render_queue)
 	{
-		if (!registry.motions.has(entity))
+		Entity entity = item.entity;
+
+		// Plain and animated sprites go through the instanced batch, everything else
+		// ends the current batch and is drawn on its own
+		const RenderRequest& render_request = frame->renderRequests.get(entity);
+		if (isBatchedSprite(render_request))
+		{
+			addSpriteInstance(entity, render_request, projection_2D);
 			continue;
-		// Note, its not very efficient to access elements indirectly via the entity
-		// albeit iterating through all Sprites in sequence. A good point to optimize
+		}
+
+		flushSpriteBatch(projection_2D);
 		drawTexturedMesh(entity, projection_2D);
 	}
+	flushSpriteBatch(projection_2D);
+	gpu_profiler.end(RenderPass::WORLD);
 
 	// Truely render to the screen
-	drawToScreen();
+	if (screen_pass) {
+		gpu_profiler.begin(RenderPass::POST);
+		drawToScreen(post_effects, { (float)world_size.x / w, (float)world_size.y / h });
+		gpu_profiler.end(RenderPass::POST);
+	}
+	gpu_profiler.begin(RenderPass::TEXT);
 	drawText(w, h);
+	gpu_profiler.end(RenderPass::TEXT);
+	endFrameStats();
 
-	// flicker-free display with a double buffer
-	glfwSwapBuffers(window);
+	// flicker-free display with a double buffer. Headless frames are not presented, waiting for
+	// the GPU instead keeps the frame times of benchmarks honest.
+	if (window)
+		glfwSwapBuffers(window);
+	else
+		glFinish();
 	gl_has_errors();
+	frame_pacer.endFrame();
 }
 
 
-mat3 RenderSystem::createProjectionMatrix() {
-	auto camera = camera_control_system->get_camera();
+vec4 RenderSystem::getCameraRect() {
+	const CameraControlSystem::Camera& camera = frame->camera;
 
 	float left = camera.position.x;
 	float right = camera.position.x + window_width_px / camera.scale;
 	float top = camera.position.y;
 	float bottom = camera.position.y + window_height_px / camera.scale;
 
+	return { left, top, right, bottom };
+}
+
+mat3 RenderSystem::createProjectionMatrix() {
+	vec4 camera_rect = getCameraRect();
+
+	float left = camera_rect.x;
+	float top = camera_rect.y;
+	float right = camera_rect.z;
+	float bottom = camera_rect.w;
+
 	// Create the orthographic projection matrix
 	float sx = 2.f / (right - left);
 	float sy = 2.f / (top - bottom); 
@@ -493,3 +906,43 @@ mat3 RenderSystem::createProjectionMatrix() {
 
 }
 
+RenderStats& RenderStats::operator+=(const RenderStats& other)
+{
+	draw_calls += other.draw_calls;
+	triangles += other.triangles;
+	program_binds += other.program_binds;
+	program_binds_skipped += other.program_binds_skipped;
+	texture_binds += other.texture_binds;
+	texture_binds_skipped += other.texture_binds_skipped;
+	upload_bytes += other.upload_bytes;
+	submitted += other.submitted;
+	culled += other.culled;
+	text_glyphs += other.text_glyphs;
+	return *this;
+}
+
+void RenderStats::write(FILE* file, uint64_t frames) const
+{
+	const double n = frames > 0 ? (double)frames : 1.0;
+	fprintf(file, "draws %.1f  triangles %.0f  programs %.1f (%.1f skipped)  textures %.1f (%.1f skipped)  "
+		"uploads %.1f KB  submitted %.1f  culled %.1f  glyphs %.0f\n",
+		draw_calls / n, triangles / n, program_binds / n, program_binds_skipped / n,
+		texture_binds / n, texture_binds_skipped / n, upload_bytes / n / 1024.0,
+		submitted / n, culled / n, text_glyphs / n);
+}
+
+void RenderSystem::endFrameStats()
+{
+	frames_drawn++;
+	render_stats_total += render_stats;
+	if (render_stats_interval <= 0)
+		return;
+
+	render_stats_interval_sum += render_stats;
+	if (frames_drawn % render_stats_interval == 0)
+	{
+		printf("Render stats per frame, last %d frames: ", render_stats_interval);
+		render_stats_interval_sum.write(stdout, render_stats_interval);
+		render_stats_interval_sum = RenderStats();
+	}
+}
@@ -1,12 +1,119 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 
 #include "common.hpp"
 #include "components.hpp"
 #include "tiny_ecs.hpp"
 #include "camera_control_system.hpp"
+#include "frame_pacer.hpp"
+#include "gpu_profiler.hpp"
+#include "headless_context.hpp"
+#include "render_snapshot.hpp"
+#include "texture_cache.hpp"
+
+// Per-instance data of the batched sprite path, matches the instance attributes of the sprite_batch shader
+struct SpriteInstance {
+	vec3 transform[3];
+	vec4 uv_rect; // offset and size of the sprite's region of the texture
+	vec4 color;   // rgb is the entity colour, alpha turns on the animated electricity effect
+};
+
+// Vertex of the batched text renderer, in framebuffer pixels
+struct TextVertex {
+	vec2 position;
+	vec2 texcoord;
+	vec4 color;
+};
+
+// One entry of the per-frame render queue. The key orders the draws by
+// layer | effect | texture | geometry | depth, from the most to the least significant bits.
+struct RenderItem {
+	uint64_t key;
+	Entity entity;
+};
+
+// Work the renderer submitted in one frame, or summed over several. Plain counters bumped next
+// to the GL calls they count, cheap enough to stay on in release builds.
+struct RenderStats {
+	uint64_t draw_calls = 0;
+	uint64_t triangles = 0;
+	uint64_t program_binds = 0;
+	uint64_t program_binds_skipped = 0;
+	uint64_t texture_binds = 0;
+	uint64_t texture_binds_skipped = 0;
+	// Vertex, instance and texture data sent to the GPU
+	uint64_t upload_bytes = 0;
+	// Entities submitted to the render queue or culled against the camera
+	uint64_t submitted = 0;
+	uint64_t culled = 0;
+	uint64_t text_glyphs = 0;
+
+	RenderStats& operator+=(const RenderStats& other);
+	// One line of the counters averaged over frames
+	void write(FILE* file, uint64_t frames) const;
+};
+
+// Effects of the screen pass, all applied by one uber shader (water.fs.glsl). While none of
+// them is active the scene is drawn straight to the window and the screen pass is skipped.
+struct PostProcessSettings {
+	bool distortion = false;
+	bool color_shift = false;
+};
+
+// Dynamic resolution: when the GPU time of the world and screen passes exceeds the budget, the
+// world is drawn to a smaller part of the off-screen target, which the screen pass upscales.
+// Text is drawn after the upscale, at native resolution.
+struct DynamicResolutionSettings {
+	bool enabled = false;
+	float target_gpu_ms = 8.f;
+	float min_scale = 0.5f;
+	float max_scale = 1.f;
+};
+
+// Bits of the post_effects uniform, keep in sync with water.fs.glsl
+const int POST_EFFECT_DISTORTION = 1;
+const int POST_EFFECT_COLOR_SHIFT = 2;
+const int POST_EFFECT_FADE = 4;
+
+// Vertex attribute locations shared by all effects, see loadEffectFromFile
+const GLuint ATTRIBUTE_POSITION = 0;
+const GLuint ATTRIBUTE_TEXCOORD = 1;
+const GLuint ATTRIBUTE_COLOR = 2;
+
+// Attribute and uniform locations of one effect, resolved once when the effects are loaded.
+// Names an effect does not use stay at -1, which glUniform* ignores.
+struct EffectLayout {
+	GLint in_position = -1;
+	GLint in_texcoord = -1;
+	GLint in_color = -1;
+
+	GLint transform = -1;
+	GLint projection = -1;
+	GLint fcolor = -1;
+	GLint color = -1;
+	GLint sprite_width = -1;
+	GLint sprite_height = -1;
+	GLint animation_frame = -1;
+	GLint animation_type = -1;
+	GLint glow_color = -1;
+	GLint glow_intensity = -1;
+	GLint player_color = -1;
+	GLint scroll_offset = -1;
+	GLint time = -1;
+	GLint screen_darken_factor = -1;
+	GLint post_effects = -1;
+	GLint render_scale = -1;
+};
 
 // System responsible for setting up OpenGL and for rendering all the
 // visual entities in the game
@@ -73,7 +180,89 @@ class RenderSystem {
 			textures_path("story/photo.png"),
 	};
 
+	// Small sprites that are packed into one atlas texture at load time. Their entries in
+	// texture_gl_handles point at the atlas, so they must be drawn through the batched sprite
+	// path which samples their region from texture_uv_rects.
+	const std::vector<TEXTURE_ASSET_ID> atlas_textures = {
+			TEXTURE_ASSET_ID::RED_HEALTH,
+			TEXTURE_ASSET_ID::GREEN_HEALTH,
+			TEXTURE_ASSET_ID::ROCKET,
+			TEXTURE_ASSET_ID::PISTOL,
+			TEXTURE_ASSET_ID::SMG,
+			TEXTURE_ASSET_ID::AR,
+			TEXTURE_ASSET_ID::SNIPER,
+			TEXTURE_ASSET_ID::SHOTGUN,
+			TEXTURE_ASSET_ID::SHOTGUN_MUZZLE,
+			TEXTURE_ASSET_ID::WEAPON_BOX,
+			TEXTURE_ASSET_ID::SPEEDBOOST,
+			TEXTURE_ASSET_ID::SUPERJUMP,
+			TEXTURE_ASSET_ID::TRIPLEJUMP,
+			TEXTURE_ASSET_ID::SMG_PICKUP,
+			TEXTURE_ASSET_ID::AR_PICKUP,
+			TEXTURE_ASSET_ID::SNIPER_PICKUP,
+			TEXTURE_ASSET_ID::SHOTGUN_PICKUP,
+			TEXTURE_ASSET_ID::RELOAD_TEXT,
+			TEXTURE_ASSET_ID::RED_ARROW,
+			TEXTURE_ASSET_ID::GREEN_ARROW,
+	};
+	GLuint atlas_gl_handle;
+	// 1x1 magenta texture drawn in place of streamed textures that failed to load
+	GLuint placeholder_gl_handle = 0;
+	std::array<bool, texture_count> texture_in_atlas;
+	// Region (offset, size) each texture occupies in its GL texture, the whole texture unless it is in the atlas
+	std::array<vec4, texture_count> texture_uv_rects;
+
+	// Full screen textures only one screen or level uses at a time. They are loaded when a screen
+	// declares them through requireTextures, and the least recently used undeclared ones are evicted
+	// once the resident bytes exceed the budget. Every other texture stays resident for the whole run.
+	const std::vector<TEXTURE_ASSET_ID> streamed_textures = {
+			TEXTURE_ASSET_ID::BACKGROUND,
+			TEXTURE_ASSET_ID::MIDDLEGROUND,
+			TEXTURE_ASSET_ID::FOREGROUND,
+			TEXTURE_ASSET_ID::MENUBACKGROUND,
+			TEXTURE_ASSET_ID::LEVELSELECTBACKGROUND,
+			TEXTURE_ASSET_ID::PLATFORM,
+			TEXTURE_ASSET_ID::TUTORIALPLATFORM,
+			TEXTURE_ASSET_ID::JUNGLEMAP,
+			TEXTURE_ASSET_ID::SPACEMAP,
+			TEXTURE_ASSET_ID::TEMPLEMAP,
+			TEXTURE_ASSET_ID::TUTORIALMAP,
+			TEXTURE_ASSET_ID::GREEN_PLAYER_WON,
+			TEXTURE_ASSET_ID::RED_PLAYER_WON,
+			TEXTURE_ASSET_ID::STORY_BLACK,
+			TEXTURE_ASSET_ID::STORY_HOUSE,
+			TEXTURE_ASSET_ID::STORY_HOUSE2,
+			TEXTURE_ASSET_ID::STORY_PHOTO,
+	};
+	// A streamed texture whose file could not be decoded is FAILED for good, it draws the placeholder
+	enum class TextureResidency { RESIDENT, LOADING, EVICTED, FAILED };
+	std::array<bool, texture_count> texture_streamed;
+	std::array<TextureResidency, texture_count> texture_residency;
+	// Frame a streamed texture was last drawn or required, the least recent one is evicted first
+	std::array<uint64_t, texture_count> texture_last_used;
+	// Declared by the current screen, never evicted until another screen declares its textures
+	std::array<bool, texture_count> texture_pinned;
+	uint64_t residency_frame = 0;
+	// Written by the thread that draws, read by getResidentTextureBytes from any thread
+	std::atomic<size_t> resident_texture_bytes{ 0 };
+	size_t reported_texture_bytes = 0;
+	std::atomic<size_t> texture_budget_bytes{ 96 * 1024 * 1024 };
+	// Textures required by the simulation since the last frame and the latest declaration,
+	// applied by the renderer
+	std::vector<int> texture_requests;
+	std::vector<int> texture_declared;
+	bool texture_declared_changed = false;
+
+	// Background thread decoding the streamed textures, uploads still happen on the GL thread
+	std::thread texture_loader;
+	std::mutex texture_load_mutex;
+	std::condition_variable texture_load_cv;
+	std::deque<int> texture_load_queue;
+	std::vector<std::pair<int, TextureImage>> texture_loaded;
+	bool texture_loader_quit = false;
+
 	std::array<GLuint, effect_count> effects;
+	std::array<EffectLayout, effect_count> effect_layouts;
 	// Make sure these paths remain in sync with the associated enumerators.
 	const std::array<std::string, effect_count> effect_paths = {
 		shader_path("coloured"),
@@ -84,27 +273,49 @@ class RenderSystem {
 		shader_path("background"),
 		shader_path("animated"),
 		shader_path("bullet"),
+		shader_path("sprite_batch"),
+		shader_path("text"),
+	};
+	// Effects no screen draws up front, compiled by getEffect the first time they are used
+	const std::vector<EFFECT_ASSET_ID> lazy_effects = {
+		EFFECT_ASSET_ID::PEBBLE,
 	};
 
 	std::array<GLuint, geometry_count> vertex_buffers;
 	std::array<GLuint, geometry_count> index_buffers;
+	std::array<GLuint, geometry_count> vertex_arrays;
+	std::array<GLsizei, geometry_count> index_counts;
 	std::array<Mesh, geometry_count> meshes;
 
 public:
-	// Initialize the window
-	bool init(GLFWwindow* window);
+	// Initialize the window. Without a window the headless context must already be current, frames
+	// are then drawn into an offscreen framebuffer of headless_size and never presented.
+	bool init(GLFWwindow* window, HeadlessContext* headless_context = nullptr,
+		ivec2 headless_size = { window_width_px, window_height_px });
 
 	template <class T>
 	void bindVBOandIBO(GEOMETRY_BUFFER_ID gid, std::vector<T> vertices, std::vector<uint16_t> indices);
 
-	void initializeGlTextures();
+	bool initializeGlTextures();
+
+	// Packs the loaded atlas textures into one texture and frees their pixels
+	void packTextureAtlas(std::array<TextureImage, texture_count>& images);
 
 	void initializeGlEffects();
+	// Program of the effect, compiling it first if it is one of the lazy effects
+	GLuint getEffect(EFFECT_ASSET_ID id);
+	bool loadEffect(EFFECT_ASSET_ID id, bool* from_cache = nullptr);
 
 	void initializeGlMeshes();
 	Mesh& getMesh(GEOMETRY_BUFFER_ID id) { return meshes[(int)id]; };
 
 	void initializeGlGeometryBuffers();
+
+	// Creates the vertex array and streaming instance buffer of the batched sprite path
+	void initializeSpriteBatch();
+
+	// Creates the vertex array and streaming buffer of the batched text renderer
+	void initializeTextBatch();
 	// Initialize the screen texture used as intermediate render target
 	// The draw loop first renders to this texture, then it is used for the water
 	// shader
@@ -116,21 +327,116 @@ public:
 	// Destroy resources associated to one or all entities created by the system
 	~RenderSystem();
 
-	// Draw all entities
+	// Draw all entities. Draws straight from the registry, or captures a snapshot of it for the
+	// render thread once startRenderThread was called.
 	void draw();
 
+	// Moves the GL context and all drawing onto a dedicated thread, draw() no longer blocks on vsync
+	void startRenderThread();
+	void stopRenderThread();
+
 	mat3 createProjectionMatrix();
+	// Visible part of the world as left, top, right, bottom
+	vec4 getCameraRect();
+
+	// Counters of the last frame drawn and their sum since startup. Like the GPU profiler, only
+	// read them on the thread that draws or after stopRenderThread.
+	const RenderStats& getRenderStats() const { return render_stats; }
+	const RenderStats& getRenderStatsTotal() const { return render_stats_total; }
+	uint64_t getFramesDrawn() const { return frames_drawn; }
+	// Prints the counters averaged over every interval of that many frames, 0 turns it off.
+	// Call before startRenderThread.
+	void setRenderStatsInterval(int frames) { render_stats_interval = frames; }
+
+	// GPU time of the world, post and text passes. Only read it on the thread that draws,
+	// or after stopRenderThread.
+	const GpuProfiler& getGpuProfiler() const { return gpu_profiler; }
+	// Logs the GPU time of every pass of every frame, call before startRenderThread
+	bool openGpuProfileLog(const std::string& path) { return gpu_profiler.openLog(path); }
+	// Draws the rolling GPU pass times in the top left corner
+	std::atomic<bool> show_gpu_overlay{ false };
+
+	// Vsync (the default), adaptive vsync, uncapped or capped at cap_fps. Sets the swap interval,
+	// so call it on the thread the context is current on, before startRenderThread.
+	void setFramePacing(FramePacing mode, float cap_fps = 0.f);
+	// Achieved frame intervals, same threading rules as the GPU profiler
+	const FramePacer& getFramePacer() const { return frame_pacer; }
+
+	PostProcessSettings post_process;
+	// Set before startRenderThread, the render thread reads it every frame
+	DynamicResolutionSettings dynamic_resolution;
+	// Fraction of the framebuffer size the world pass currently renders at
+	float getRenderScale() const { return render_scale; }
+
+	// Declares the streamed textures a screen or level is about to draw, replacing the ones the previous
+	// screen declared. From the next frame on the missing ones load in the background, frames skip the
+	// sprites whose texture is still loading, and none of them is evicted until the next declaration.
+	// Safe to call from the simulation while a render thread is running.
+	void requireTextures(const std::vector<TEXTURE_ASSET_ID>& textures);
+	void setTextureBudget(size_t bytes);
+	// Safe to call from the simulation while a render thread is running
+	size_t getResidentTextureBytes() const { return resident_texture_bytes.load(); }
 
 private:
 	CameraControlSystem* camera_control_system;
 	// Internal drawing functions for each entity type
+	Transform getEntityTransform(Entity entity);
 	void drawTexturedMesh(Entity entity, const mat3& projection);
-	void drawToScreen();
+	// Sprites sharing an effect and a texture are collected and drawn with one instanced draw call
+	bool isBatchedSprite(const RenderRequest& render_request);
+	void addSpriteInstance(Entity entity, const RenderRequest& render_request, const mat3& projection);
+	void flushSpriteBatch(const mat3& projection);
+
+	// Builds the render queue of all drawable entities and sorts it by key
+	void buildRenderQueue();
+	uint64_t makeSortKey(Entity entity, const RenderRequest& render_request);
+	// Bind only if different from what the queue last bound
+	void useProgram(GLuint program);
+	void bindTexture(GLuint texture);
+	// Uploads finished background loads, makes sure every queued texture is resident and evicts over budget
+	void updateTextureResidency();
+	void uploadTexture(int index, TextureImage& image);
+	void evictTextures();
+	void textureLoaderLoop();
+	// Bits of the post effects this frame needs, 0 when the screen pass can be skipped
+	int activePostEffects();
+	void drawToScreen(int post_effects, vec2 scale);
+	RenderFrameState captureFrameState();
+	void captureSnapshot(RenderSnapshot& snapshot);
+	void drawFrame();
+	void renderThreadLoop();
 	void drawAnimated(Entity entity, EFFECT_ASSET_ID asset_id);
 	void drawText(int viewportWidth, int viewportHeight);
+	GpuProfiler gpu_profiler;
+	FramePacer frame_pacer;
+
+	// Dynamic resolution state, adjusted from the GPU times as their results come back
+	float render_scale = 1.f;
+	float scaled_gpu_ms = 0.f;
+	int scaled_gpu_samples = 0;
+	int frames_since_rescale = 0;
+	void updateRenderScale();
 
-	// Window handle
+	// Window handle, null when rendering headless
 	GLFWwindow* window;
+	HeadlessContext* headless_context = nullptr;
+	ivec2 headless_size = { 0, 0 };
+	std::chrono::steady_clock::time_point headless_start;
+	ivec2 getFramebufferSize();
+
+	// Framebuffer that ends each frame, 0 for the window or the offscreen one when headless
+	GLuint screen_framebuffer = 0;
+	GLuint screen_color = 0;
+	GLuint screen_depth = 0;
+	void initHeadlessFramebuffer();
+
+	// Snapshots handed from the simulation to the renderer, and what the current frame draws
+	SnapshotTripleBuffer snapshots;
+	RenderFrame* frame = nullptr;
+	std::thread render_thread;
+	std::atomic<bool> render_thread_quit{ false };
+	// Makes the window's or the headless context current on the calling thread, or releases it
+	void makeContextCurrent(bool current);
 
 	// Screen texture handles
 	GLuint frame_buffer;
@@ -141,8 +447,60 @@ private:
 
 
 	GLuint vao_rebind;
+
+	// Batched sprite path
+	GLuint sprite_batch_vao;
+	GLuint sprite_instance_vbo;
+	std::vector<SpriteInstance> sprite_instances;
+	GLuint sprite_batch_texture = 0;
+
+	// Render queue, rebuilt and sorted every frame
+	std::vector<RenderItem> render_queue;
+	std::vector<RenderItem> render_queue_scratch;
+	RenderStats render_stats;
+	RenderStats render_stats_total;
+	RenderStats render_stats_interval_sum;
+	uint64_t frames_drawn = 0;
+	int render_stats_interval = 0;
+	void countDraw(GLsizei indices, GLsizei instances = 1);
+	void endFrameStats();
+	GLuint bound_program = 0;
+	GLuint bound_texture = 0;
 	bool initTextRender = false;
+
+	// Glyph layout of every text entity, keyed by entity id
+	struct CachedText {
+		struct Glyph {
+			float x, y, width;
+			float u1, v1, u2, v2;
+		};
+		std::vector<Glyph> glyphs;
+		std::string string;
+		float width = 0.f;  // in font pixels, before scaling
+		float height = 0.f;
+		bool built = false;
+		bool used = false;
+	};
+	std::unordered_map<unsigned int, CachedText> text_cache;
+	void buildTextGlyphs(CachedText& cached);
+	// Appends the glyph quads of a laid out text, placed and scaled like the text entity
+	void appendTextVertices(const CachedText& cached, const Text& text, vec2 viewport_scale, float scaling_factor);
+	// Lines of the GPU overlay, laid out like text entities
+	std::vector<CachedText> overlay_text;
+	void appendGpuOverlay(vec2 viewport_scale, float scaling_factor);
+
+	// Streaming vertex buffer all text is drawn from
+	GLuint text_vao;
+	GLuint text_vbo;
+	std::vector<TextVertex> text_vertices;
 };
 
+// Links the program from its cached binary when the driver supports it and the sources and
+// driver are unchanged, and otherwise compiles the sources and caches the resulting binary
 bool loadEffectFromFile(
-	const std::string& vs_path, const std::string& fs_path, GLuint& out_program);
+	const std::string& vs_path, const std::string& fs_path, GLuint& out_program, bool* from_cache = nullptr);
+
+EffectLayout resolveEffectLayout(GLuint program);
+#ifndef NDEBUG
+void validateEffectLayout(EFFECT_ASSET_ID effect, GLuint program);
+#endif
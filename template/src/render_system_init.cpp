@@ -1,10 +1,16 @@
 // internal
 #include "render_system.hpp"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
 #include <fstream>
-
-#include "../ext/stb_image/stb_image.h"
+#include <mutex>
+#include <thread>
 
 // This creates circular header inclusion, that is quite bad.
 #include "tiny_ecs_registry.hpp"
@@ -16,12 +22,19 @@
 #include "../ext/gltext/gltext.h"
 
 // World initialization
-bool RenderSystem::init(GLFWwindow* window_arg)
+bool RenderSystem::init(GLFWwindow* window_arg, HeadlessContext* headless_context_arg, ivec2 headless_size_arg)
 {
 	this->window = window_arg;
+	this->headless_context = headless_context_arg;
+	this->headless_size = headless_size_arg;
+	headless_start = std::chrono::steady_clock::now();
 
-	glfwMakeContextCurrent(window);
-	glfwSwapInterval(1); // vsync
+	// A headless context was made current by its creator, see HeadlessContext
+	if (window)
+	{
+		glfwMakeContextCurrent(window);
+		glfwSwapInterval(frame_pacer.swapInterval()); // vsync until setFramePacing says otherwise
+	}
 
 	// Load OpenGL function pointers
 	const int is_fine = gl3w_init();
@@ -35,12 +48,11 @@ bool RenderSystem::init(GLFWwindow* window_arg)
 
 	// For some high DPI displays (ex. Retina Display on Macbooks)
 	// https://stackoverflow.com/questions/36672935/why-retina-screen-coordinate-value-is-twice-the-value-of-pixel-value
-	int frame_buffer_width_px, frame_buffer_height_px;
-	glfwGetFramebufferSize(window, &frame_buffer_width_px, &frame_buffer_height_px);  // Note, this will be 2x the resolution given to glfwCreateWindow on retina displays
-	if (frame_buffer_width_px != window_width_px)
+	const ivec2 frame_buffer_size = getFramebufferSize();
+	if (frame_buffer_size.x != window_width_px)
 	{
 		printf("WARNING: retina display! https://stackoverflow.com/questions/36672935/why-retina-screen-coordinate-value-is-twice-the-value-of-pixel-value\n");
-		printf("glfwGetFramebufferSize = %d,%d\n", frame_buffer_width_px, frame_buffer_height_px);
+		printf("glfwGetFramebufferSize = %d,%d\n", frame_buffer_size.x, frame_buffer_size.y);
 		printf("window width_height = %d,%d\n", window_width_px, window_height_px);
 	}
 
@@ -57,57 +69,534 @@ bool RenderSystem::init(GLFWwindow* window_arg)
 	gl_has_errors();
 
 	initScreenTexture();
-    initializeGlTextures();
+	if (!window)
+		initHeadlessFramebuffer();
+	if (!initializeGlTextures())
+		return false;
 	initializeGlEffects();
 	initializeGlGeometryBuffers();
+	initializeSpriteBatch();
+	initializeTextBatch();
+	gpu_profiler.init();
 
 	return true;
 }
 
-void RenderSystem::initializeGlTextures()
+bool RenderSystem::initializeGlTextures()
 {
-    glGenTextures((GLsizei)texture_gl_handles.size(), texture_gl_handles.data());
+	texture_gl_handles.fill(0);
+
+	texture_in_atlas.fill(false);
+	for (TEXTURE_ASSET_ID id : atlas_textures)
+		texture_in_atlas[(int)id] = true;
+	std::array<TextureImage, texture_count> atlas_pixels;
+
+	// Streamed textures are left for the residency manager to load once a screen requires them
+	texture_streamed.fill(false);
+	texture_residency.fill(TextureResidency::RESIDENT);
+	texture_last_used.fill(0);
+	texture_pinned.fill(false);
+	std::vector<int> startup_textures;
+	for (TEXTURE_ASSET_ID id : streamed_textures)
+	{
+		texture_streamed[(int)id] = true;
+		texture_residency[(int)id] = TextureResidency::EVICTED;
+	}
+	for (int i = 0; i < texture_count; i++)
+	{
+		if (!texture_streamed[i])
+			startup_textures.push_back(i);
+	}
+	const int startup_count = (int)startup_textures.size();
+
+	const unsigned char placeholder_pixel[4] = { 255, 0, 255, 255 };
+	glGenTextures(1, &placeholder_gl_handle);
+	glBindTexture(GL_TEXTURE_2D, placeholder_gl_handle);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder_pixel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+	auto load_start = std::chrono::high_resolution_clock::now();
 
-    for(uint i = 0; i < texture_paths.size(); i++)
-    {
-		const std::string& path = texture_paths[i];
-		ivec2& dimensions = texture_dimensions[i];
+	// Decoding the PNGs dominates startup, so it runs on worker threads (or is skipped entirely
+	// when the cooked cache is warm). GL calls have to stay on this thread, which uploads
+	// every texture as soon as its worker hands it over.
+	std::atomic<int> next_texture(0);
+	std::mutex decoded_mutex;
+	std::condition_variable decoded_cv;
+	std::vector<std::pair<int, TextureImage>> decoded;
+	int cache_hits = 0;
 
-		stbi_uc* data;
-		data = stbi_load(path.c_str(), &dimensions.x, &dimensions.y, NULL, 4);
+	unsigned int worker_count = std::max(1u, std::min(std::thread::hardware_concurrency(), (unsigned int)startup_count));
+	std::vector<std::thread> workers;
+	for (unsigned int w = 0; w < worker_count; w++)
+	{
+		workers.emplace_back([&]() {
+			for (int next = next_texture++; next < startup_count; next = next_texture++)
+			{
+				const int i = startup_textures[next];
+				TextureImage image;
+				loadTexture(texture_paths[i], image);
+				{
+					std::lock_guard<std::mutex> lock(decoded_mutex);
+					texture_dimensions[i] = image.dimensions;
+					if (image.storage == TextureImage::Storage::MAPPED || image.storage == TextureImage::Storage::READ)
+						cache_hits++;
+					decoded.push_back({ i, image });
+				}
+				decoded_cv.notify_one();
+			}
+		});
+	}
 
-		if (data == NULL)
+	bool decode_failed = false;
+	for (int uploaded = 0; uploaded < startup_count; uploaded++)
+	{
+		int i;
+		TextureImage image;
 		{
-			const std::string message = "Could not load the file " + path + ".";
-			fprintf(stderr, "%s", message.c_str());
-			assert(false);
+			std::unique_lock<std::mutex> lock(decoded_mutex);
+			decoded_cv.wait(lock, [&decoded]() { return !decoded.empty(); });
+			i = decoded.back().first;
+			image = decoded.back().second;
+			decoded.pop_back();
 		}
-		glBindTexture(GL_TEXTURE_2D, texture_gl_handles[i]);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dimensions.x, dimensions.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		gl_has_errors();
-		stbi_image_free(data);
-    }
+
+		// A missing or corrupt file stops the startup once the workers are done
+		if (image.pixels == NULL)
+		{
+			fprintf(stderr, "Could not load the file %s\n", texture_paths[i].c_str());
+			decode_failed = true;
+			continue;
+		}
+
+		// Atlas textures are uploaded together once all of them are loaded
+		if (texture_in_atlas[i])
+		{
+			atlas_pixels[i] = image;
+			continue;
+		}
+		uploadTexture(i, image);
+	}
+
+	for (std::thread& worker : workers)
+		worker.join();
+
+	if (decode_failed)
+	{
+		for (TextureImage& image : atlas_pixels)
+			freeTexture(image);
+		return false;
+	}
+	packTextureAtlas(atlas_pixels);
+	gl_has_errors();
+
+	float load_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - load_start).count();
+	printf("Loaded %d textures (%d from the cache) on %u threads in %.1f ms\n", startup_count, cache_hits, worker_count, load_ms);
+
+	texture_loader = std::thread(&RenderSystem::textureLoaderLoop, this);
+	return true;
+}
+
+void RenderSystem::uploadTexture(int index, TextureImage& image)
+{
+	// Startup textures are checked before they get here, only a streamed one can fail
+	if (image.pixels == NULL)
+	{
+		assert(texture_streamed[index]);
+		fprintf(stderr, "Could not load the file %s, drawing a placeholder\n", texture_paths[index].c_str());
+		texture_gl_handles[index] = placeholder_gl_handle;
+		texture_dimensions[index] = { 1, 1 };
+		texture_uv_rects[index] = { 0.f, 0.f, 1.f, 1.f };
+		texture_residency[index] = TextureResidency::FAILED;
+		return;
+	}
+
+	// A copy, freeTexture resets the image
+	const ivec2 dimensions = image.dimensions;
+	texture_dimensions[index] = dimensions;
+	if (texture_gl_handles[index] == 0)
+		glGenTextures(1, &texture_gl_handles[index]);
+	glBindTexture(GL_TEXTURE_2D, texture_gl_handles[index]);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dimensions.x, dimensions.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	gl_has_errors();
+	freeTexture(image);
+	texture_uv_rects[index] = { 0.f, 0.f, 1.f, 1.f };
+	texture_residency[index] = TextureResidency::RESIDENT;
+	resident_texture_bytes += (size_t)dimensions.x * dimensions.y * 4;
+	render_stats.upload_bytes += (uint64_t)dimensions.x * dimensions.y * 4;
+}
+
+void RenderSystem::textureLoaderLoop()
+{
+	while (true)
+	{
+		int i;
+		{
+			std::unique_lock<std::mutex> lock(texture_load_mutex);
+			texture_load_cv.wait(lock, [this]() { return texture_loader_quit || !texture_load_queue.empty(); });
+			if (texture_loader_quit)
+				return;
+			i = texture_load_queue.front();
+			texture_load_queue.pop_front();
+		}
+
+		TextureImage image;
+		loadTexture(texture_paths[i], image);
+		{
+			std::lock_guard<std::mutex> lock(texture_load_mutex);
+			texture_loaded.push_back({ i, image });
+		}
+		texture_load_cv.notify_all();
+	}
+}
+
+void RenderSystem::requireTextures(const std::vector<TEXTURE_ASSET_ID>& textures)
+{
+	std::lock_guard<std::mutex> lock(texture_load_mutex);
+	texture_declared.clear();
+	for (TEXTURE_ASSET_ID id : textures)
+	{
+		assert(texture_streamed[(int)id]);
+		texture_requests.push_back((int)id);
+		texture_declared.push_back((int)id);
+	}
+	texture_declared_changed = true;
+}
+
+void RenderSystem::setTextureBudget(size_t bytes)
+{
+	// Evicting takes GL calls, so it waits for the next frame
+	texture_budget_bytes = bytes;
+}
+
+void RenderSystem::updateTextureResidency()
+{
+	residency_frame++;
+
+	// Queue what the simulation required since the last frame
+	{
+		std::lock_guard<std::mutex> lock(texture_load_mutex);
+		for (int i : texture_requests)
+		{
+			texture_last_used[i] = std::max(texture_last_used[i], residency_frame);
+			if (texture_residency[i] == TextureResidency::EVICTED)
+			{
+				texture_residency[i] = TextureResidency::LOADING;
+				texture_load_queue.push_back(i);
+			}
+		}
+		texture_requests.clear();
+
+		// The previous screen's textures become evictable
+		if (texture_declared_changed)
+		{
+			texture_pinned.fill(false);
+			for (int i : texture_declared)
+				texture_pinned[i] = true;
+			texture_declared_changed = false;
+		}
+	}
+	texture_load_cv.notify_all();
+
+	// Streamed textures in this frame's queue that are not on the GPU yet
+	std::vector<int> missing;
+	for (const RenderItem& item : render_queue)
+	{
+		const int i = (int)frame->renderRequests.get(item.entity).used_texture;
+		if (i >= texture_count || !texture_streamed[i])
+			continue;
+		texture_last_used[i] = residency_frame;
+		if (texture_residency[i] != TextureResidency::RESIDENT && texture_residency[i] != TextureResidency::FAILED &&
+			std::find(missing.begin(), missing.end(), i) == missing.end())
+			missing.push_back(i);
+	}
+
+	std::vector<std::pair<int, TextureImage>> loaded;
+	{
+		std::lock_guard<std::mutex> lock(texture_load_mutex);
+		for (int i : missing)
+		{
+			// Not required or evicted since, load it now at the front of the queue
+			if (texture_residency[i] == TextureResidency::EVICTED)
+			{
+				fprintf(stderr, "Texture %s was not resident when drawn\n", texture_paths[i].c_str());
+				texture_residency[i] = TextureResidency::LOADING;
+				texture_load_queue.push_front(i);
+			}
+		}
+		// Whatever the loader has finished so far, the frame does not wait for the rest
+		loaded.swap(texture_loaded);
+	}
+	if (!missing.empty())
+		texture_load_cv.notify_all();
+
+	for (auto& entry : loaded)
+		uploadTexture(entry.first, entry.second);
+
+	// Sprites whose texture is still loading are left out of this frame
+	if (!missing.empty())
+	{
+		render_queue.erase(std::remove_if(render_queue.begin(), render_queue.end(), [this](const RenderItem& item) {
+			const int i = (int)frame->renderRequests.get(item.entity).used_texture;
+			return i < texture_count && texture_residency[i] == TextureResidency::LOADING;
+		}), render_queue.end());
+	}
+
+	evictTextures();
+
+	if (resident_texture_bytes != reported_texture_bytes)
+	{
+		printf("Resident textures: %.1f MB (budget %.1f MB)\n",
+			resident_texture_bytes.load() / (1024.f * 1024.f), texture_budget_bytes.load() / (1024.f * 1024.f));
+		reported_texture_bytes = resident_texture_bytes;
+	}
+}
+
+void RenderSystem::evictTextures()
+{
+	// Least recently used first, never what this frame draws or what the current screen declared
+	while (resident_texture_bytes.load() > texture_budget_bytes.load())
+	{
+		int victim = -1;
+		for (TEXTURE_ASSET_ID id : streamed_textures)
+		{
+			const int i = (int)id;
+			if (texture_residency[i] != TextureResidency::RESIDENT || texture_pinned[i] || texture_last_used[i] >= residency_frame)
+				continue;
+			if (victim < 0 || texture_last_used[i] < texture_last_used[victim])
+				victim = i;
+		}
+		if (victim < 0)
+			break;
+
+		glDeleteTextures(1, &texture_gl_handles[victim]);
+		texture_gl_handles[victim] = 0;
+		texture_residency[victim] = TextureResidency::EVICTED;
+		resident_texture_bytes -= (size_t)texture_dimensions[victim].x * texture_dimensions[victim].y * 4;
+	}
+}
+
+void RenderSystem::packTextureAtlas(std::array<TextureImage, texture_count>& images)
+{
+	// Transparent border around every sprite so linear filtering does not bleed into its neighbours
+	const int ATLAS_WIDTH = 1024;
+	const int ATLAS_PADDING = 2;
+
+	// Shelf packing: tallest sprites first, each shelf is as tall as its first sprite
+	std::vector<TEXTURE_ASSET_ID> order = atlas_textures;
+	std::sort(order.begin(), order.end(), [this](TEXTURE_ASSET_ID a, TEXTURE_ASSET_ID b) {
+		return texture_dimensions[(int)a].y > texture_dimensions[(int)b].y;
+	});
+
+	std::array<ivec2, texture_count> offsets;
+	int x = 0;
+	int shelf_y = 0;
+	int shelf_height = 0;
+	for (TEXTURE_ASSET_ID id : order)
+	{
+		ivec2 size = texture_dimensions[(int)id] + ivec2(2 * ATLAS_PADDING);
+		assert(size.x <= ATLAS_WIDTH);
+		if (x + size.x > ATLAS_WIDTH)
+		{
+			shelf_y += shelf_height;
+			x = 0;
+			shelf_height = 0;
+		}
+		offsets[(int)id] = { x + ATLAS_PADDING, shelf_y + ATLAS_PADDING };
+		x += size.x;
+		shelf_height = max(shelf_height, size.y);
+	}
+	const int atlas_height = shelf_y + shelf_height;
+
+	// Copy every sprite into its place, row by row
+	std::vector<unsigned char> atlas((size_t)ATLAS_WIDTH * atlas_height * 4, 0);
+	for (TEXTURE_ASSET_ID id : atlas_textures)
+	{
+		const int i = (int)id;
+		const ivec2& dimensions = texture_dimensions[i];
+		for (int row = 0; row < dimensions.y; row++)
+		{
+			memcpy(&atlas[((size_t)(offsets[i].y + row) * ATLAS_WIDTH + offsets[i].x) * 4],
+				&images[i].pixels[(size_t)row * dimensions.x * 4], (size_t)dimensions.x * 4);
+		}
+		freeTexture(images[i]);
+
+		texture_uv_rects[i] = {
+			(float)offsets[i].x / ATLAS_WIDTH, (float)offsets[i].y / atlas_height,
+			(float)dimensions.x / ATLAS_WIDTH, (float)dimensions.y / atlas_height };
+	}
+
+	glGenTextures(1, &atlas_gl_handle);
+	glBindTexture(GL_TEXTURE_2D, atlas_gl_handle);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, ATLAS_WIDTH, atlas_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, atlas.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	gl_has_errors();
+	resident_texture_bytes += (size_t)ATLAS_WIDTH * atlas_height * 4;
+
+	// The atlas textures share the atlas handle from now on
+	for (TEXTURE_ASSET_ID id : atlas_textures)
+		texture_gl_handles[(int)id] = atlas_gl_handle;
+
+	printf("Packed %d textures into a %dx%d atlas\n", (int)atlas_textures.size(), ATLAS_WIDTH, atlas_height);
 }
 
 void RenderSystem::initializeGlEffects()
 {
+	auto load_start = std::chrono::high_resolution_clock::now();
+
+	effects.fill(0);
+	int loaded = 0;
+	int cache_hits = 0;
 	for(uint i = 0; i < effect_paths.size(); i++)
 	{
-		const std::string vertex_shader_name = effect_paths[i] + ".vs.glsl";
-		const std::string fragment_shader_name = effect_paths[i] + ".fs.glsl";
+		if (std::find(lazy_effects.begin(), lazy_effects.end(), (EFFECT_ASSET_ID)i) != lazy_effects.end())
+			continue;
+
+		bool from_cache = false;
+		loadEffect((EFFECT_ASSET_ID)i, &from_cache);
+		loaded++;
+		cache_hits += from_cache ? 1 : 0;
+	}
+	gl_has_errors();
+
+	float load_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - load_start).count();
+	printf("Loaded %d effects (%d from the program cache, %d deferred) in %.1f ms\n",
+		loaded, cache_hits, (int)lazy_effects.size(), load_ms);
+}
+
+bool RenderSystem::loadEffect(EFFECT_ASSET_ID id, bool* from_cache)
+{
+	const int i = (int)id;
+	const std::string vertex_shader_name = effect_paths[i] + ".vs.glsl";
+	const std::string fragment_shader_name = effect_paths[i] + ".fs.glsl";
+
+	bool is_valid = loadEffectFromFile(vertex_shader_name, fragment_shader_name, effects[i], from_cache);
+	assert(is_valid && (GLuint)effects[i] != 0);
+
+	effect_layouts[i] = resolveEffectLayout(effects[i]);
+#ifndef NDEBUG
+	validateEffectLayout(id, effects[i]);
+#endif
+	return is_valid;
+}
+
+GLuint RenderSystem::getEffect(EFFECT_ASSET_ID id)
+{
+	if (effects[(int)id] == 0)
+	{
+		auto load_start = std::chrono::high_resolution_clock::now();
+		loadEffect(id);
+		float load_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - load_start).count();
+		printf("Loaded deferred effect %s in %.1f ms\n", effect_paths[(int)id].c_str(), load_ms);
+	}
+	return effects[(int)id];
+}
+
+EffectLayout resolveEffectLayout(GLuint program)
+{
+	EffectLayout layout;
+	layout.in_position = glGetAttribLocation(program, "in_position");
+	layout.in_texcoord = glGetAttribLocation(program, "in_texcoord");
+	layout.in_color = glGetAttribLocation(program, "in_color");
+
+	layout.transform = glGetUniformLocation(program, "transform");
+	layout.projection = glGetUniformLocation(program, "projection");
+	layout.fcolor = glGetUniformLocation(program, "fcolor");
+	layout.color = glGetUniformLocation(program, "color");
+	layout.sprite_width = glGetUniformLocation(program, "sprite_width");
+	layout.sprite_height = glGetUniformLocation(program, "sprite_height");
+	layout.animation_frame = glGetUniformLocation(program, "animation_frame");
+	layout.animation_type = glGetUniformLocation(program, "animation_type");
+	layout.glow_color = glGetUniformLocation(program, "glowColor");
+	layout.glow_intensity = glGetUniformLocation(program, "glowIntensity");
+	layout.player_color = glGetUniformLocation(program, "chosenPlayerColor");
+	layout.scroll_offset = glGetUniformLocation(program, "uScrollOffset");
+	layout.time = glGetUniformLocation(program, "time");
+	layout.screen_darken_factor = glGetUniformLocation(program, "screen_darken_factor");
+	layout.post_effects = glGetUniformLocation(program, "post_effects");
+	layout.render_scale = glGetUniformLocation(program, "render_scale");
+	gl_has_errors();
+	return layout;
+}
+
+#ifndef NDEBUG
+void validateEffectLayout(EFFECT_ASSET_ID effect, GLuint program)
+{
+	// Names the draw code relies on for each effect, in the order of EFFECT_ASSET_ID.
+	// A shader that renames or stops using one of them trips the assert below.
+	static const std::array<std::vector<std::string>, effect_count> expected_names = { {
+		{ "in_position", "transform", "projection", "color" },
+		{ "in_position", "transform", "projection" },
+		{ "in_position", "in_texcoord", "transform", "projection", "sprite_width", "sprite_height", "animation_frame", "animation_type", "glowColor", "glowIntensity", "chosenPlayerColor" },
+		{ "in_position", "in_texcoord", "transform", "projection", "fcolor" },
+		{ "in_position", "screen_darken_factor", "post_effects", "render_scale" },
+		{ "in_position", "in_texcoord", "transform", "projection", "fcolor", "uScrollOffset" },
+		{ "in_position", "in_texcoord", "transform", "projection", "fcolor", "sprite_width", "sprite_height", "animation_frame", "animation_type" },
+		{ "in_position", "in_color", "transform", "projection", "color" },
+		{ "projection" },
+		{ "in_position", "in_texcoord", "in_color", "projection" },
+	} };
 
-		bool is_valid = loadEffectFromFile(vertex_shader_name, fragment_shader_name, effects[i]);
-		assert(is_valid && (GLuint)effects[i] != 0);
+	bool is_valid = true;
+	for (const std::string& name : expected_names[(int)effect])
+	{
+		if (glGetAttribLocation(program, name.c_str()) < 0 && glGetUniformLocation(program, name.c_str()) < 0)
+		{
+			fprintf(stderr, "Effect %d does not expose %s\n", (int)effect, name.c_str());
+			is_valid = false;
+		}
+	}
+
+	// Attributes must sit at the locations the geometry vertex arrays use
+	EffectLayout layout = resolveEffectLayout(program);
+	if ((layout.in_position >= 0 && layout.in_position != (GLint)ATTRIBUTE_POSITION) ||
+		(layout.in_texcoord >= 0 && layout.in_texcoord != (GLint)ATTRIBUTE_TEXCOORD) ||
+		(layout.in_color >= 0 && layout.in_color != (GLint)ATTRIBUTE_COLOR))
+	{
+		fprintf(stderr, "Effect %d does not use the shared attribute locations\n", (int)effect);
+		is_valid = false;
 	}
+	gl_has_errors();
+	assert(is_valid);
 }
+#endif
 
 // One could merge the following two functions as a template function...
+// Attribute layouts of the vertex types, using the fixed locations bound in loadEffectFromFile
+static void setVertexAttributes(const TexturedVertex*)
+{
+	glEnableVertexAttribArray(ATTRIBUTE_POSITION);
+	glVertexAttribPointer(ATTRIBUTE_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)0);
+	glEnableVertexAttribArray(ATTRIBUTE_TEXCOORD);
+	glVertexAttribPointer(ATTRIBUTE_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)sizeof(vec3));
+}
+
+static void setVertexAttributes(const ColoredVertex*)
+{
+	glEnableVertexAttribArray(ATTRIBUTE_POSITION);
+	glVertexAttribPointer(ATTRIBUTE_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void*)0);
+	glEnableVertexAttribArray(ATTRIBUTE_COLOR);
+	glVertexAttribPointer(ATTRIBUTE_COLOR, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void*)sizeof(vec3));
+}
+
+static void setVertexAttributes(const vec3*)
+{
+	glEnableVertexAttribArray(ATTRIBUTE_POSITION);
+	glVertexAttribPointer(ATTRIBUTE_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void*)0);
+}
+
 template <class T>
 void RenderSystem::bindVBOandIBO(GEOMETRY_BUFFER_ID gid, std::vector<T> vertices, std::vector<uint16_t> indices)
 {
+	// The vertex array records the buffers and attribute layout of the geometry
+	glBindVertexArray(vertex_arrays[(uint)gid]);
+
 	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[(uint)gid]);
 	glBufferData(GL_ARRAY_BUFFER,
 		sizeof(vertices[0]) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
@@ -117,6 +606,12 @@ void RenderSystem::bindVBOandIBO(GEOMETRY_BUFFER_ID gid, std::vector<T> vertices
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
 		sizeof(indices[0]) * indices.size(), indices.data(), GL_STATIC_DRAW);
 	gl_has_errors();
+
+	setVertexAttributes((const T*)nullptr);
+	index_counts[(uint)gid] = (GLsizei)indices.size();
+
+	glBindVertexArray(vao_rebind);
+	gl_has_errors();
 }
 
 void RenderSystem::initializeGlMeshes()
@@ -143,6 +638,9 @@ void RenderSystem::initializeGlGeometryBuffers()
 	glGenBuffers((GLsizei)vertex_buffers.size(), vertex_buffers.data());
 	// Index Buffer creation.
 	glGenBuffers((GLsizei)index_buffers.size(), index_buffers.data());
+	// Vertex Array creation, one per geometry.
+	glGenVertexArrays((GLsizei)vertex_arrays.size(), vertex_arrays.data());
+	index_counts.fill(0);
 
 	// Index and Vertex buffer data initialization.
 	initializeGlMeshes();
@@ -233,8 +731,76 @@ void RenderSystem::initializeGlGeometryBuffers()
 
 }
 
+void RenderSystem::initializeSpriteBatch()
+{
+	glGenVertexArrays(1, &sprite_batch_vao);
+	glGenBuffers(1, &sprite_instance_vbo);
+	glBindVertexArray(sprite_batch_vao);
+	gl_has_errors();
+
+	// Per-vertex data comes from the sprite quad, locations match the sprite_batch shader
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[(GLuint)GEOMETRY_BUFFER_ID::SPRITE]);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[(GLuint)GEOMETRY_BUFFER_ID::SPRITE]);
+	setVertexAttributes((const TexturedVertex*)nullptr);
+	gl_has_errors();
+
+	// Per-instance data advances once per sprite
+	glBindBuffer(GL_ARRAY_BUFFER, sprite_instance_vbo);
+	for (GLuint column = 0; column < 3; column++)
+	{
+		glEnableVertexAttribArray(2 + column);
+		glVertexAttribPointer(2 + column, 3, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance),
+			(void*)(offsetof(SpriteInstance, transform) + column * sizeof(vec3)));
+		glVertexAttribDivisor(2 + column, 1);
+	}
+	glEnableVertexAttribArray(5);
+	glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), (void*)offsetof(SpriteInstance, uv_rect));
+	glVertexAttribDivisor(5, 1);
+	glEnableVertexAttribArray(6);
+	glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), (void*)offsetof(SpriteInstance, color));
+	glVertexAttribDivisor(6, 1);
+	gl_has_errors();
+
+	glBindVertexArray(vao_rebind);
+	gl_has_errors();
+}
+
+void RenderSystem::initializeTextBatch()
+{
+	glGenVertexArrays(1, &text_vao);
+	glGenBuffers(1, &text_vbo);
+	glBindVertexArray(text_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, text_vbo);
+	gl_has_errors();
+
+	glEnableVertexAttribArray(ATTRIBUTE_POSITION);
+	glVertexAttribPointer(ATTRIBUTE_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)offsetof(TextVertex, position));
+	glEnableVertexAttribArray(ATTRIBUTE_TEXCOORD);
+	glVertexAttribPointer(ATTRIBUTE_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)offsetof(TextVertex, texcoord));
+	glEnableVertexAttribArray(ATTRIBUTE_COLOR);
+	glVertexAttribPointer(ATTRIBUTE_COLOR, 4, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)offsetof(TextVertex, color));
+	gl_has_errors();
+
+	glBindVertexArray(vao_rebind);
+	gl_has_errors();
+}
+
 RenderSystem::~RenderSystem()
 {
+	// The GL resources below are released on this thread
+	stopRenderThread();
+
+	// Stop the texture loader before its GL handles go away
+	{
+		std::lock_guard<std::mutex> lock(texture_load_mutex);
+		texture_loader_quit = true;
+	}
+	texture_load_cv.notify_all();
+	if (texture_loader.joinable())
+		texture_loader.join();
+	for (auto& entry : texture_loaded)
+		freeTexture(entry.second);
+
 	// Terminate text render library
 	gltTerminate();
 	gl_has_errors();
@@ -243,7 +809,14 @@ RenderSystem::~RenderSystem()
 	// but it's polite to clean after yourself.
 	glDeleteBuffers((GLsizei)vertex_buffers.size(), vertex_buffers.data());
 	glDeleteBuffers((GLsizei)index_buffers.size(), index_buffers.data());
+	glDeleteVertexArrays((GLsizei)vertex_arrays.size(), vertex_arrays.data());
+	glDeleteBuffers(1, &sprite_instance_vbo);
+	glDeleteBuffers(1, &text_vbo);
+	glDeleteVertexArrays(1, &text_vao);
+	glDeleteVertexArrays(1, &sprite_batch_vao);
+	// The atlas and placeholder handles appear several times in texture_gl_handles, GL ignores names already deleted
 	glDeleteTextures((GLsizei)texture_gl_handles.size(), texture_gl_handles.data());
+	glDeleteTextures(1, &placeholder_gl_handle);
 	glDeleteTextures(1, &off_screen_render_buffer_color);
 	glDeleteRenderbuffers(1, &off_screen_render_buffer_depth);
 	gl_has_errors();
@@ -253,6 +826,13 @@ RenderSystem::~RenderSystem()
 	}
 	// delete allocated resources
 	glDeleteFramebuffers(1, &frame_buffer);
+	gpu_profiler.destroy();
+	if (screen_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &screen_framebuffer);
+		glDeleteRenderbuffers(1, &screen_color);
+		glDeleteRenderbuffers(1, &screen_depth);
+	}
 	gl_has_errors();
 
 	// remove all entities created by the render system
@@ -265,8 +845,9 @@ bool RenderSystem::initScreenTexture()
 {
 	registry.screenStates.emplace(screen_state_entity);
 
-	int framebuffer_width, framebuffer_height;
-	glfwGetFramebufferSize(const_cast<GLFWwindow*>(window), &framebuffer_width, &framebuffer_height);  // Note, this will be 2x the resolution given to glfwCreateWindow on retina displays
+	const ivec2 framebuffer_size = getFramebufferSize();
+	const int framebuffer_width = framebuffer_size.x;
+	const int framebuffer_height = framebuffer_size.y;
 
 	glGenTextures(1, &off_screen_render_buffer_color);
 	glBindTexture(GL_TEXTURE_2D, off_screen_render_buffer_color);
@@ -287,6 +868,49 @@ bool RenderSystem::initScreenTexture()
 	return true;
 }
 
+void RenderSystem::setFramePacing(FramePacing mode, float cap_fps)
+{
+	if (mode == FramePacing::ADAPTIVE && window &&
+		!glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+	{
+		printf("Adaptive vsync is not supported by the driver, using vsync\n");
+		mode = FramePacing::VSYNC;
+	}
+	frame_pacer.configure(mode, cap_fps);
+	if (window)
+		glfwSwapInterval(frame_pacer.swapInterval());
+}
+
+ivec2 RenderSystem::getFramebufferSize()
+{
+	if (!window)
+		return headless_size;
+	ivec2 size;
+	glfwGetFramebufferSize(window, &size.x, &size.y);  // Note, this will be 2x the resolution given to glfwCreateWindow on retina displays
+	return size;
+}
+
+// Stands in for the window's default framebuffer when rendering headless
+void RenderSystem::initHeadlessFramebuffer()
+{
+	glGenFramebuffers(1, &screen_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, screen_framebuffer);
+
+	glGenRenderbuffers(1, &screen_color);
+	glBindRenderbuffer(GL_RENDERBUFFER, screen_color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, headless_size.x, headless_size.y);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, screen_color);
+
+	glGenRenderbuffers(1, &screen_depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, screen_depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, headless_size.x, headless_size.y);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, screen_depth);
+	gl_has_errors();
+
+	assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
+}
+
 bool gl_compile_shader(GLuint shader)
 {
 	glCompileShader(shader);
@@ -310,8 +934,116 @@ bool gl_compile_shader(GLuint shader)
 	return true;
 }
 
+// Bump the version whenever the layout of the cached program files changes
+static const char PROGRAM_CACHE_MAGIC[4] = { 'B', 'B', 'P', 'B' };
+static const uint32_t PROGRAM_CACHE_VERSION = 1;
+// glGetError reports one flag per call, a context has only a handful of them
+static const int MAX_DRAINED_GL_ERRORS = 16;
+
+struct ProgramCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t format;
+	uint32_t length;
+};
+
+// Core since 4.1, older contexts may still expose it through GL_ARB_get_program_binary
+static bool programBinariesSupported()
+{
+	static int supported = -1;
+	if (supported < 0)
+	{
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		bool available = major > 4 || (major == 4 && minor >= 1);
+		GLint extension_count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+		for (GLint i = 0; i < extension_count && !available; i++)
+			available = strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_ARB_get_program_binary") == 0;
+
+		GLint format_count = 0;
+		if (available && glProgramBinary != NULL && glGetProgramBinary != NULL)
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+		gl_has_errors();
+		supported = format_count > 0 ? 1 : 0;
+	}
+	return supported == 1;
+}
+
+static bool loadProgramBinary(const std::string& path, uint64_t key, GLuint& out_program)
+{
+	std::ifstream stream(path, std::ios::binary | std::ios::ate);
+	if (!stream)
+		return false;
+	const std::streamoff file_size = stream.tellg();
+	stream.seekg(0);
+	ProgramCacheHeader header;
+	if (file_size < (std::streamoff)sizeof(header) || !stream.read((char*)&header, sizeof(header)))
+		return false;
+	if (memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC)) != 0 ||
+		header.version != PROGRAM_CACHE_VERSION || header.key != key)
+		return false;
+	// A truncated or corrupt file is a miss, not a huge allocation
+	if (header.length == 0 || header.length != (uint64_t)(file_size - (std::streamoff)sizeof(header)))
+		return false;
+	std::vector<char> binary(header.length);
+	if (!stream.read(binary.data(), binary.size()))
+		return false;
+
+	// Drain older errors so the check below only sees glProgramBinary's
+	for (int i = 0; i < MAX_DRAINED_GL_ERRORS && glGetError() != GL_NO_ERROR; i++) {}
+	out_program = glCreateProgram();
+	glProgramBinary(out_program, header.format, binary.data(), (GLsizei)binary.size());
+	// A driver update can reject binaries it wrote itself, which just means compiling again
+	bool rejected = false;
+	for (int i = 0; i < MAX_DRAINED_GL_ERRORS && glGetError() != GL_NO_ERROR; i++)
+		rejected = true;
+	GLint is_linked = GL_FALSE;
+	if (!rejected)
+		glGetProgramiv(out_program, GL_LINK_STATUS, &is_linked);
+	if (is_linked == GL_FALSE)
+	{
+		glDeleteProgram(out_program);
+		out_program = 0;
+		return false;
+	}
+	return true;
+}
+
+static void saveProgramBinary(const std::string& path, uint64_t key, GLuint program)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	ProgramCacheHeader header;
+	memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC));
+	header.version = PROGRAM_CACHE_VERSION;
+	header.key = key;
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+	gl_has_errors();
+	header.format = format;
+	header.length = (uint32_t)length;
+
+	create_cache_dir();
+	std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+	if (!stream)
+	{
+		fprintf(stderr, "Could not write the program cache %s\n", path.c_str());
+		return;
+	}
+	stream.write((const char*)&header, sizeof(header));
+	stream.write(binary.data(), length);
+}
+
 bool loadEffectFromFile(
-	const std::string& vs_path, const std::string& fs_path, GLuint& out_program)
+	const std::string& vs_path, const std::string& fs_path, GLuint& out_program, bool* from_cache)
 {
 	// Opening files
 	std::ifstream vs_is(vs_path);
@@ -334,6 +1066,29 @@ bool loadEffectFromFile(
 	GLsizei vs_len = (GLsizei)vs_str.size();
 	GLsizei fs_len = (GLsizei)fs_str.size();
 
+	// Binaries are only valid for the driver that produced them, so it is part of the key
+	// along with both sources and the attribute locations bound before linking
+	const bool use_binaries = programBinariesSupported();
+	const int attribute_locations[] = { ATTRIBUTE_POSITION, ATTRIBUTE_TEXCOORD, ATTRIBUTE_COLOR };
+	uint64_t key = hash_bytes(vs_str.data(), vs_str.size());
+	key = hash_bytes(fs_str.data(), fs_str.size(), key);
+	key = hash_bytes(attribute_locations, sizeof(attribute_locations), key);
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+	{
+		const char* value = (const char*)glGetString(name);
+		if (value != NULL)
+			key = hash_bytes(value, strlen(value), key);
+	}
+	const std::string binary_path = cache_path(vs_path.substr(vs_path.find_last_of("/\\") + 1) + ".program");
+	if (from_cache != nullptr)
+		*from_cache = false;
+	if (use_binaries && loadProgramBinary(binary_path, key, out_program))
+	{
+		if (from_cache != nullptr)
+			*from_cache = true;
+		return true;
+	}
+
 	GLuint vertex = glCreateShader(GL_VERTEX_SHADER);
 	glShaderSource(vertex, 1, &vs_src, &vs_len);
 	GLuint fragment = glCreateShader(GL_FRAGMENT_SHADER);
@@ -358,6 +1113,14 @@ bool loadEffectFromFile(
 	out_program = glCreateProgram();
 	glAttachShader(out_program, vertex);
 	glAttachShader(out_program, fragment);
+
+	// Every effect reads its vertex attributes from the same locations, so the per-geometry
+	// vertex arrays work with any of them
+	glBindAttribLocation(out_program, ATTRIBUTE_POSITION, "in_position");
+	glBindAttribLocation(out_program, ATTRIBUTE_TEXCOORD, "in_texcoord");
+	glBindAttribLocation(out_program, ATTRIBUTE_COLOR, "in_color");
+	if (use_binaries)
+		glProgramParameteri(out_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(out_program);
 	gl_has_errors();
 
@@ -386,6 +1149,9 @@ bool loadEffectFromFile(
 	glDeleteShader(fragment);
 	gl_has_errors();
 
+	if (use_binaries)
+		saveProgramBinary(binary_path, key, out_program);
+
 	return true;
 }
 
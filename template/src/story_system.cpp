@@ -7,6 +7,8 @@
 #include "tiny_ecs_registry.hpp"
 #include "world_init.hpp"
 
+#include <algorithm>
+
 
 void StorySystem::init(RenderSystem* renderer, GameStateSystem* game_state_system, SoundSystem* sound_system) {
 	this->renderer = renderer;
@@ -25,6 +27,14 @@ void StorySystem::init(RenderSystem* renderer, GameStateSystem* game_state_syste
 	frames.push_back({ "I will find you...", TEXTURE_ASSET_ID::STORY_PHOTO });
 	frames.push_back({ "And I will never forgive you.", TEXTURE_ASSET_ID::STORY_BLACK });
 
+	std::vector<TEXTURE_ASSET_ID> frame_textures;
+	for (const auto& frame : frames)
+	{
+		if (std::find(frame_textures.begin(), frame_textures.end(), frame.background) == frame_textures.end())
+			frame_textures.push_back(frame.background);
+	}
+	renderer->requireTextures(frame_textures);
+
 	render_frame(current_frame);
 
 	sound_system->play_burning_sound();
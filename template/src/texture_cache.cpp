@@ -0,0 +1,186 @@
+#include "texture_cache.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "../ext/stb_image/stb_image.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// Bump the version whenever the layout of the cooked files changes
+	const char CACHE_MAGIC[4] = { 'B', 'B', 'T', 'X' };
+	const uint32_t CACHE_VERSION = 1;
+
+	struct CacheHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t source_hash;
+		int32_t width;
+		int32_t height;
+	};
+
+	// data/textures/foo/bar.png -> data/cache/foo_bar.png.rgba
+	std::string cache_file(const std::string& source)
+	{
+		std::string name = source;
+		const std::string textures_dir = textures_path("");
+		if (name.compare(0, textures_dir.size(), textures_dir) == 0)
+			name = name.substr(textures_dir.size());
+		for (char& c : name)
+		{
+			if (c == '/' || c == '\\' || c == ':')
+				c = '_';
+		}
+		return cache_path(name + ".rgba");
+	}
+
+	bool header_matches(const CacheHeader& header, uint64_t source_hash, size_t file_size)
+	{
+		return memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0
+			&& header.version == CACHE_VERSION
+			&& header.source_hash == source_hash
+			&& header.width > 0 && header.height > 0
+			&& file_size == sizeof(CacheHeader) + (size_t)header.width * header.height * 4;
+	}
+
+	// Maps (or on Windows reads) the cache entry, returns false when it is missing or stale
+	bool read_cache(const std::string& file, uint64_t source_hash, TextureImage& image)
+	{
+#ifdef _WIN32
+		std::ifstream stream(file, std::ios::binary);
+		if (!stream)
+			return false;
+		CacheHeader header;
+		if (!stream.read((char*)&header, sizeof(header)))
+			return false;
+		stream.seekg(0, std::ios::end);
+		size_t file_size = (size_t)stream.tellg();
+		if (!header_matches(header, source_hash, file_size))
+			return false;
+
+		size_t pixel_bytes = file_size - sizeof(header);
+		unsigned char* pixels = (unsigned char*)malloc(pixel_bytes);
+		stream.seekg(sizeof(header), std::ios::beg);
+		if (!stream.read((char*)pixels, pixel_bytes))
+		{
+			free(pixels);
+			return false;
+		}
+		image.pixels = pixels;
+		image.dimensions = { header.width, header.height };
+		image.storage = TextureImage::Storage::READ;
+		return true;
+#else
+		int fd = open(file.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat info;
+		if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(CacheHeader))
+		{
+			close(fd);
+			return false;
+		}
+		size_t file_size = (size_t)info.st_size;
+		void* mapping = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (mapping == MAP_FAILED)
+			return false;
+
+		CacheHeader header;
+		memcpy(&header, mapping, sizeof(header));
+		if (!header_matches(header, source_hash, file_size))
+		{
+			munmap(mapping, file_size);
+			return false;
+		}
+		image.pixels = (unsigned char*)mapping + sizeof(CacheHeader);
+		image.dimensions = { header.width, header.height };
+		image.storage = TextureImage::Storage::MAPPED;
+		image.mapping = mapping;
+		image.mapping_size = file_size;
+		return true;
+#endif
+	}
+
+	void write_cache(const std::string& file, uint64_t source_hash, const TextureImage& image)
+	{
+		create_cache_dir();
+		CacheHeader header;
+		memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+		header.version = CACHE_VERSION;
+		header.source_hash = source_hash;
+		header.width = image.dimensions.x;
+		header.height = image.dimensions.y;
+
+		// Written next to the entry and renamed over it, so a reader never sees half a file
+		const std::string temp_file = file + ".tmp";
+		{
+			std::ofstream stream(temp_file, std::ios::binary | std::ios::trunc);
+			if (!stream)
+			{
+				fprintf(stderr, "Could not write the texture cache %s\n", temp_file.c_str());
+				return;
+			}
+			stream.write((const char*)&header, sizeof(header));
+			stream.write((const char*)image.pixels, (std::streamsize)image.dimensions.x * image.dimensions.y * 4);
+		}
+		std::remove(file.c_str());
+		if (std::rename(temp_file.c_str(), file.c_str()) != 0)
+			std::remove(temp_file.c_str());
+	}
+}
+
+bool loadTexture(const std::string& path, TextureImage& image)
+{
+	// The source still has to be read to hash it, but that is cheap next to inflating it
+	std::ifstream stream(path, std::ios::binary);
+	if (!stream)
+		return false;
+	std::vector<unsigned char> source((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+	uint64_t source_hash = hash_bytes(source.data(), source.size());
+
+	const std::string file = cache_file(path);
+	if (read_cache(file, source_hash, image))
+		return true;
+
+	image.pixels = stbi_load_from_memory(source.data(), (int)source.size(), &image.dimensions.x, &image.dimensions.y, NULL, 4);
+	if (image.pixels == NULL)
+		return false;
+	image.storage = TextureImage::Storage::DECODED;
+	write_cache(file, source_hash, image);
+	return true;
+}
+
+void freeTexture(TextureImage& image)
+{
+	switch (image.storage)
+	{
+	case TextureImage::Storage::DECODED:
+		stbi_image_free(image.pixels);
+		break;
+	case TextureImage::Storage::READ:
+		free(image.pixels);
+		break;
+	case TextureImage::Storage::MAPPED:
+#ifndef _WIN32
+		munmap(image.mapping, image.mapping_size);
+#endif
+		break;
+	case TextureImage::Storage::NONE:
+		break;
+	}
+	image = TextureImage();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "common.hpp"
+
+// Cooked texture cache: every PNG is decoded once into raw RGBA stored under data/cache/
+// with a small header, later runs map that file and upload it to GL without decoding.
+// Entries are keyed on a hash of the source PNG, so an edited texture is recooked on the next run.
+
+// RGBA pixels of one texture, either mapped from its cache entry or decoded by stb_image
+struct TextureImage
+{
+	enum class Storage { NONE, DECODED, MAPPED, READ };
+
+	unsigned char* pixels = nullptr;
+	ivec2 dimensions = { 0, 0 };
+	Storage storage = Storage::NONE;
+
+	// Start and size of the mapped cache file when storage is MAPPED
+	void* mapping = nullptr;
+	size_t mapping_size = 0;
+};
+
+// Loads the texture at path, (re)cooking its cache entry when it is missing or stale.
+// Safe to call from several threads at once as long as they load different files.
+bool loadTexture(const std::string& path, TextureImage& image);
+
+void freeTexture(TextureImage& image);
@@ -135,3 +135,114 @@ public:
 			map_entity_componentID[entities[i]] = i;
 	}
 };
+
+
+// Lifecycle of a contact between two entities across physics steps
+enum class ContactPhase
+{
+	Begin, // first step the pair is touching
+	Stay,  // pair was already touching in the previous step
+	End    // pair stopped touching, reported until the handler erases it
+};
+
+// A container of contacts keyed by entity pair that persists across frames.
+// Unlike the collision containers, contacts are not cleared every frame: detection touches
+// the pairs it finds and the container turns that into Begin, Stay and End transitions.
+// A handful of contacts are alive at any time, so pairs are found by a linear scan and the
+// vector keeps its capacity from frame to frame.
+template <typename ContactData>
+class ContactContainer : public ContainerInterface
+{
+public:
+	struct Contact
+	{
+		Entity first;
+		Entity second;
+		ContactPhase phase;
+		bool touched;
+		ContactData data;
+	};
+
+	std::vector<Contact> contacts;
+
+	// Call before detection: resets the touch flags
+	void begin_step()
+	{
+		for (Contact& contact : contacts)
+			contact.touched = false;
+	}
+
+	// Records that the pair is touching in this step
+	Contact& touch(Entity first, Entity second)
+	{
+		for (Contact& contact : contacts)
+		{
+			if (contact.first == first && contact.second == second)
+			{
+				contact.phase = ContactPhase::Stay;
+				contact.touched = true;
+				return contact;
+			}
+		}
+		contacts.push_back({ first, second, ContactPhase::Begin, true, ContactData() });
+		return contacts.back();
+	}
+
+	// Call after detection: every contact that was not touched in this step ends
+	void end_step()
+	{
+		for (Contact& contact : contacts)
+		{
+			if (!contact.touched)
+				contact.phase = ContactPhase::End;
+		}
+	}
+
+	// Call once the handler has seen the End transitions: drops the contacts that ended
+	void erase_ended()
+	{
+		for (size_t i = 0; i < contacts.size();)
+		{
+			if (contacts[i].phase == ContactPhase::End)
+			{
+				contacts[i] = std::move(contacts.back());
+				contacts.pop_back();
+				continue;
+			}
+			i++;
+		}
+	}
+
+	// Contacts of a removed entity end and stay until erase_ended, so that handlers still see the transition
+	void remove(Entity e)
+	{
+		for (Contact& contact : contacts)
+		{
+			if (contact.first == e || contact.second == e)
+			{
+				contact.phase = ContactPhase::End;
+				contact.touched = false;
+			}
+		}
+	}
+
+	bool has(Entity entity)
+	{
+		for (Contact& contact : contacts)
+		{
+			if (contact.first == entity || contact.second == entity)
+				return true;
+		}
+		return false;
+	}
+
+	void clear()
+	{
+		contacts.clear();
+	}
+
+	size_t size()
+	{
+		return contacts.size();
+	}
+};
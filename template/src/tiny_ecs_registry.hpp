@@ -13,11 +13,12 @@ public:
 	// Manually created list of all components this game has
 	ComponentContainer<Friction> friction;
 	ComponentContainer<Gravity> gravity;
+	ComponentContainer<RestingBody> restingBodies;
 	ComponentContainer<DeathTimer> deathTimers;
 	ComponentContainer<Motion> motions;
 
 	// Collision containers
-	ComponentContainer<PlayerPlatformCollision> playerPlatformCollisions;
+	ContactContainer<PlayerPlatformContact> playerPlatformContacts;
 	ComponentContainer<PlayerPlatformCollision> playerPowerUpCollisions;
 	ComponentContainer<PlayerBulletCollision> playerBulletCollisions;
 	ComponentContainer<PlayerMysteryBoxCollision> playerMysteryBoxCollisions;
@@ -61,6 +62,7 @@ public:
 		// TODO: A1 add a LightUp component
 		registry_list.push_back(&friction);
 		registry_list.push_back(&gravity);
+		registry_list.push_back(&restingBodies);
 		registry_list.push_back(&deathTimers);
 		registry_list.push_back(&motions);
 		registry_list.push_back(&players);
@@ -96,7 +98,7 @@ public:
 		registry_list.push_back(&greenBullet);
 
 		// Collisions
-		registry_list.push_back(&playerPlatformCollisions);
+		registry_list.push_back(&playerPlatformContacts);
 		registry_list.push_back(&playerPowerUpCollisions);
 		registry_list.push_back(&playerBulletCollisions);
 		registry_list.push_back(&playerMysteryBoxCollisions);
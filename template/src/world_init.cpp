@@ -49,6 +49,7 @@ Entity createPlayer(RenderSystem* renderer, GameStateSystem* game_state_system,
 			health_motion.velocity = { 0.f, 0.f };
 			health_motion.position = { start_x + i * 60.f, 50.f };
 			health_motion.scale = { 50.f, 50.f };
+			registry.restingBodies.emplace(health_entity);
 			/*registry.renderRequests.insert(
 				health_entity,
 				{ health,
@@ -62,7 +63,8 @@ Entity createPlayer(RenderSystem* renderer, GameStateSystem* game_state_system,
 		entity,
 		{ TEXTURE_ASSET_ID::PLAYER_SPRITESHEET,
 		 EFFECT_ASSET_ID::PLAYER,
-		 GEOMETRY_BUFFER_ID::ANIMATED_SPRITE });
+		 GEOMETRY_BUFFER_ID::ANIMATED_SPRITE,
+		 RENDER_LAYER::PLAYERS });
 
 	return entity;
 }
@@ -110,6 +112,7 @@ Entity createPlatform(RenderSystem* renderer, vec3 color, vec2 position, vec2 si
 	// Setting initial values, scale is negative to make it face the opposite way
 	motion.scale = size;
 	registry.platforms.emplace(entity);
+	registry.restingBodies.emplace(entity);
 
 	// registry.renderRequests.insert(
 	// 	entity,
@@ -177,7 +180,8 @@ Entity createPopupIndicator(RenderSystem* renderer, std::string popup_type, Enti
 		entity,
 		{ texture_id, // TEXTURE_COUNT indicates that no texture is needed
 			EFFECT_ASSET_ID::TEXTURED,
-			GEOMETRY_BUFFER_ID::SPRITE });
+			GEOMETRY_BUFFER_ID::SPRITE,
+			RENDER_LAYER::HUD });
 
 	return entity;
 }
@@ -233,7 +237,8 @@ Entity createBullet(RenderSystem* renderer, Entity gunEntity) {
 		entity,
 		{ TEXTURE_ASSET_ID::TEXTURE_COUNT, // TEXTURE_COUNT indicates that no texture is needed
 			EFFECT_ASSET_ID::BULLET,
-			GEOMETRY_BUFFER_ID::BULLET });
+			GEOMETRY_BUFFER_ID::BULLET,
+			RENDER_LAYER::PROJECTILES });
 
 	return entity;
 }
@@ -286,7 +291,8 @@ Entity createProjectile(RenderSystem* renderer, bool isProjectile, vec2 pos, Ent
 			entity,
 			{ TEXTURE_ASSET_ID::TEXTURE_COUNT, // TEXTURE_COUNT indicates that no texture is needed
 				EFFECT_ASSET_ID::COLOURED,
-				GEOMETRY_BUFFER_ID::PROJECTILE });
+				GEOMETRY_BUFFER_ID::PROJECTILE,
+				RENDER_LAYER::PROJECTILES });
 		return entity;
 	}
 
@@ -298,7 +304,8 @@ Entity createProjectile(RenderSystem* renderer, bool isProjectile, vec2 pos, Ent
 		entity,
 		{ TEXTURE_ASSET_ID::TEXTURE_COUNT, // TEXTURE_COUNT indicates that no texture is needed
 			EFFECT_ASSET_ID::COLOURED,
-			GEOMETRY_BUFFER_ID::BULLET });
+			GEOMETRY_BUFFER_ID::BULLET,
+			RENDER_LAYER::PROJECTILES });
 
 	return entity;
 }
@@ -319,6 +326,8 @@ Entity createPowerup(RenderSystem* renderSystem, vec2 pos, vec2 scale, vec3 colo
 
 	motion.scale = scale;
 
+	registry.restingBodies.emplace(entity);
+
 	Interpolation& interpolation = registry.interpolation.emplace(entity);
 	interpolation.startPosition = pos;
 	interpolation.endPosition = { pos.x + 100, pos.y };
@@ -336,7 +345,8 @@ Entity createPowerup(RenderSystem* renderSystem, vec2 pos, vec2 scale, vec3 colo
 		entity,
 		{ TEXTURE_ASSET_ID::POWERUP_SPRITESHEET,
 			EFFECT_ASSET_ID::ANIMATED,
-			GEOMETRY_BUFFER_ID::ANIMATED_SPRITE });
+			GEOMETRY_BUFFER_ID::ANIMATED_SPRITE,
+			RENDER_LAYER::PICKUPS });
 
 
 	return entity;
@@ -357,6 +367,7 @@ Entity createGunMysteryBox(RenderSystem* renderSystem, vec2 pos, vec2 scale)
 	motion.velocity = { 0.f, 0.f };
 
 	motion.scale = scale;
+	registry.restingBodies.emplace(entity);
 
 	/*registry.colors.insert(entity, {0.0f, 255.0f, 0.0f});*/
 
@@ -364,7 +375,8 @@ Entity createGunMysteryBox(RenderSystem* renderSystem, vec2 pos, vec2 scale)
 		entity,
 		{ TEXTURE_ASSET_ID::WEAPON_BOX,
 			EFFECT_ASSET_ID::TEXTURED,
-			GEOMETRY_BUFFER_ID::SPRITE });
+			GEOMETRY_BUFFER_ID::SPRITE,
+			RENDER_LAYER::PICKUPS });
 
 	return entity;
 }
@@ -387,28 +399,32 @@ Entity createGun(RenderSystem* renderSystem, vec2 scale, std::string gun_name)
 			entity,
 			{ TEXTURE_ASSET_ID::SMG,
 				EFFECT_ASSET_ID::TEXTURED,
-				GEOMETRY_BUFFER_ID::SPRITE });
+				GEOMETRY_BUFFER_ID::SPRITE,
+				RENDER_LAYER::WEAPONS });
 	}
 	else if (gun_name == "ASSAULT RIFLE") {
 		registry.renderRequests.insert(
 			entity,
 			{ TEXTURE_ASSET_ID::AR,
 				EFFECT_ASSET_ID::TEXTURED,
-				GEOMETRY_BUFFER_ID::SPRITE });
+				GEOMETRY_BUFFER_ID::SPRITE,
+				RENDER_LAYER::WEAPONS });
 	}
 	else if (gun_name == "SNIPER RIFLE") {
 		registry.renderRequests.insert(
 			entity,
 			{ TEXTURE_ASSET_ID::SNIPER,
 				EFFECT_ASSET_ID::TEXTURED,
-				GEOMETRY_BUFFER_ID::SPRITE });
+				GEOMETRY_BUFFER_ID::SPRITE,
+				RENDER_LAYER::WEAPONS });
 	}
 	else if (gun_name == "SHOTGUN") {
 		registry.renderRequests.insert(
 			entity,
 			{ TEXTURE_ASSET_ID::SHOTGUN,
 				EFFECT_ASSET_ID::TEXTURED,
-				GEOMETRY_BUFFER_ID::SPRITE });
+				GEOMETRY_BUFFER_ID::SPRITE,
+				RENDER_LAYER::WEAPONS });
 	}
 	else {
 		// default case should be pistol
@@ -416,7 +432,8 @@ Entity createGun(RenderSystem* renderSystem, vec2 scale, std::string gun_name)
 			entity,
 			{ TEXTURE_ASSET_ID::PISTOL,
 				EFFECT_ASSET_ID::TEXTURED,
-				GEOMETRY_BUFFER_ID::SPRITE });
+				GEOMETRY_BUFFER_ID::SPRITE,
+				RENDER_LAYER::WEAPONS });
 	}
 
 
@@ -444,7 +461,8 @@ Entity createMuzzleFlash(RenderSystem* renderSystem, Motion& motion, bool facing
 		entity,
 		{ TEXTURE_ASSET_ID::SHOTGUN_MUZZLE,
 		 EFFECT_ASSET_ID::TEXTURED,
-		 GEOMETRY_BUFFER_ID::SPRITE });
+		 GEOMETRY_BUFFER_ID::SPRITE,
+		 RENDER_LAYER::MUZZLE_FLASHES });
 
 	return entity;
 }	
@@ -470,13 +488,15 @@ Entity createBackgroundIsland(RenderSystem* renderer, GameStateSystem* game_stat
 		entity,
 		{ TEXTURE_ASSET_ID::PLATFORM,
 			EFFECT_ASSET_ID::BACKGROUND,
-			GEOMETRY_BUFFER_ID::SPRITE });
+			GEOMETRY_BUFFER_ID::SPRITE,
+			RENDER_LAYER::MAP });
 	} else if (game_state_system->get_current_state() == 3) {
 		registry.renderRequests.insert(
 		entity,
 		{ TEXTURE_ASSET_ID::TUTORIALMAP,
 			EFFECT_ASSET_ID::BACKGROUND,
-			GEOMETRY_BUFFER_ID::SPRITE });
+			GEOMETRY_BUFFER_ID::SPRITE,
+			RENDER_LAYER::MAP });
 	}
 
 	return entity;
@@ -503,7 +523,8 @@ Entity createBackgroundBack(RenderSystem* renderer, vec2 position, vec2 size)
 		entity,
 		{ TEXTURE_ASSET_ID::BACKGROUND,
 			EFFECT_ASSET_ID::BACKGROUND,
-			GEOMETRY_BUFFER_ID::SPRITE });
+			GEOMETRY_BUFFER_ID::SPRITE,
+			RENDER_LAYER::BACKGROUND_BACK });
 
 	return entity;
 }
@@ -530,7 +551,8 @@ Entity createBackgroundMiddle(RenderSystem* renderer, vec2 position, vec2 size)
 		entity,
 		{ TEXTURE_ASSET_ID::MIDDLEGROUND,
 			EFFECT_ASSET_ID::BACKGROUND,
-			GEOMETRY_BUFFER_ID::SPRITE });
+			GEOMETRY_BUFFER_ID::SPRITE,
+			RENDER_LAYER::BACKGROUND_MIDDLE });
 
 	return entity;
 }
@@ -560,7 +582,8 @@ Entity createBackgroundForeground(RenderSystem* renderer, vec2 position, vec2 si
 		entity,
 		{ TEXTURE_ASSET_ID::FOREGROUND,
 			EFFECT_ASSET_ID::BACKGROUND,
-			GEOMETRY_BUFFER_ID::SPRITE });
+			GEOMETRY_BUFFER_ID::SPRITE,
+			RENDER_LAYER::BACKGROUND_FRONT });
 
 	return entity;
 }
@@ -586,14 +609,16 @@ Entity createBackgroundJungle(RenderSystem* renderer, GameStateSystem* game_stat
 			entity,
 			{ TEXTURE_ASSET_ID::JUNGLEMAP,
 				EFFECT_ASSET_ID::BACKGROUND,
-				GEOMETRY_BUFFER_ID::SPRITE });
+				GEOMETRY_BUFFER_ID::SPRITE,
+				RENDER_LAYER::MAP });
 	}
 	else if (game_state_system->get_current_state() == 3) {
 		registry.renderRequests.insert(
 			entity,
 			{ TEXTURE_ASSET_ID::TUTORIALMAP,
 				EFFECT_ASSET_ID::BACKGROUND,
-				GEOMETRY_BUFFER_ID::SPRITE });
+				GEOMETRY_BUFFER_ID::SPRITE,
+				RENDER_LAYER::MAP });
 	}
 
 	return entity;
@@ -620,14 +645,16 @@ Entity createBackgroundSpace(RenderSystem* renderer, GameStateSystem* game_state
 			entity,
 			{ TEXTURE_ASSET_ID::SPACEMAP,
 				EFFECT_ASSET_ID::BACKGROUND,
-				GEOMETRY_BUFFER_ID::SPRITE });
+				GEOMETRY_BUFFER_ID::SPRITE,
+				RENDER_LAYER::MAP });
 	}
 	else if (game_state_system->get_current_state() == 3) {
 		registry.renderRequests.insert(
 			entity,
 			{ TEXTURE_ASSET_ID::TUTORIALMAP,
 				EFFECT_ASSET_ID::BACKGROUND,
-				GEOMETRY_BUFFER_ID::SPRITE });
+				GEOMETRY_BUFFER_ID::SPRITE,
+				RENDER_LAYER::MAP });
 	}
 
 	return entity;
@@ -654,14 +681,16 @@ Entity createBackgroundTemple(RenderSystem* renderer, GameStateSystem* game_stat
 			entity,
 			{ TEXTURE_ASSET_ID::TEMPLEMAP,
 				EFFECT_ASSET_ID::BACKGROUND,
-				GEOMETRY_BUFFER_ID::SPRITE });
+				GEOMETRY_BUFFER_ID::SPRITE,
+				RENDER_LAYER::MAP });
 	}
 	else if (game_state_system->get_current_state() == 3) {
 		registry.renderRequests.insert(
 			entity,
 			{ TEXTURE_ASSET_ID::TUTORIALMAP,
 				EFFECT_ASSET_ID::BACKGROUND,
-				GEOMETRY_BUFFER_ID::SPRITE });
+				GEOMETRY_BUFFER_ID::SPRITE,
+				RENDER_LAYER::MAP });
 	}
 
 	return entity;
@@ -688,7 +717,8 @@ Entity createBackgroundTutorial(RenderSystem* renderer, GameStateSystem* game_st
 		entity,
 		{ TEXTURE_ASSET_ID::TUTORIALMAP,
 			EFFECT_ASSET_ID::BACKGROUND,
-			GEOMETRY_BUFFER_ID::SPRITE });
+			GEOMETRY_BUFFER_ID::SPRITE,
+			RENDER_LAYER::MAP });
 	
 	return entity;
 }
@@ -712,6 +742,7 @@ Entity createText(std::string text, vec2 position, vec3 color, float scale, floa
 	textObj.total_fade_time = timer;
 	// Put into motion but do nothing
 	registry.motions.emplace(entity);
+	registry.restingBodies.emplace(entity);
 	if (timer != -1) {
 		// Text for players death log
 		registry.deathLog.emplace(entity);
@@ -746,7 +777,8 @@ std::tuple<Entity, Entity> createStoryFrame(RenderSystem* renderer, std::string
 		entity,
 		{ background_image,
 		 EFFECT_ASSET_ID::BACKGROUND,
-		 GEOMETRY_BUFFER_ID::SPRITE });
+		 GEOMETRY_BUFFER_ID::SPRITE,
+		 RENDER_LAYER::BACKGROUND_BACK });
 
 	return std::make_tuple( entity, text_entity );
 }
@@ -791,6 +823,29 @@ void createTutorialMap(RenderSystem* renderer, GameStateSystem* game_state_syste
 	createPlatform(renderer, { 255.0f, 0.1f, 0.1f }, { 600, 633 }, { 792, 10 }); // Bottom
 }
 
+std::vector<TEXTURE_ASSET_ID> getMapTextures(GameStateSystem* game_state_system)
+{
+	// Keep in sync with the backgrounds the create*Map functions insert
+	if (game_state_system->get_current_state() == 3)
+		return { TEXTURE_ASSET_ID::TUTORIALMAP };
+	if (game_state_system->get_current_state() != 2)
+		return {};
+
+	switch (game_state_system->get_current_level())
+	{
+	case 1:
+		return { TEXTURE_ASSET_ID::BACKGROUND, TEXTURE_ASSET_ID::MIDDLEGROUND, TEXTURE_ASSET_ID::FOREGROUND, TEXTURE_ASSET_ID::PLATFORM };
+	case 2:
+		return { TEXTURE_ASSET_ID::JUNGLEMAP };
+	case 3:
+		return { TEXTURE_ASSET_ID::SPACEMAP };
+	case 4:
+		return { TEXTURE_ASSET_ID::TEMPLEMAP };
+	default:
+		return {};
+	}
+}
+
 void createIslandMap(RenderSystem* renderer, GameStateSystem* game_state_system, int window_width_px, int window_height_px)
 {
 	createBackgroundBack(renderer, { window_width_px / 2, window_height_px / 2 }, { window_width_px + 200, window_height_px });
@@ -870,12 +925,18 @@ Entity createRocket(RenderSystem* renderer, vec2 position) {
 		entity,
 		{ TEXTURE_ASSET_ID::ROCKET,
 		  EFFECT_ASSET_ID::TEXTURED,
-		  GEOMETRY_BUFFER_ID::SPRITE });
+		  GEOMETRY_BUFFER_ID::SPRITE,
+		  RENDER_LAYER::PROJECTILES });
 
 	return entity;
 }
 
 void createDeathScreen(RenderSystem* renderer, GameStateSystem* game_state_system, const vec2& position, const vec2& size) {
+	if (game_state_system->get_winner() == 1)
+		renderer->requireTextures({ TEXTURE_ASSET_ID::RED_PLAYER_WON });
+	else if (game_state_system->get_winner() == 2)
+		renderer->requireTextures({ TEXTURE_ASSET_ID::GREEN_PLAYER_WON });
+
 	// Reserve an entity
 	auto entity = Entity();
 
@@ -896,13 +957,15 @@ void createDeathScreen(RenderSystem* renderer, GameStateSystem* game_state_syste
 			entity,
 			{ TEXTURE_ASSET_ID::RED_PLAYER_WON,
 			  EFFECT_ASSET_ID::BACKGROUND,
-			  GEOMETRY_BUFFER_ID::SPRITE });
+			  GEOMETRY_BUFFER_ID::SPRITE,
+			  RENDER_LAYER::BACKGROUND_BACK });
 	} else if (game_state_system->get_winner() == 2) {
 		registry.renderRequests.insert(
 			entity,
 			{ TEXTURE_ASSET_ID::GREEN_PLAYER_WON,
 			  EFFECT_ASSET_ID::BACKGROUND,
-			  GEOMETRY_BUFFER_ID::SPRITE });
+			  GEOMETRY_BUFFER_ID::SPRITE,
+			  RENDER_LAYER::BACKGROUND_BACK });
 	}
 	auto player1 = createPlayer(renderer, game_state_system, { 900, 300 });
 	registry.players.get(player1).color = { 1.f, 0.f, 0.f };
@@ -48,5 +48,7 @@ void createJungleMap(RenderSystem* renderer, GameStateSystem* game_state_system,
 void createSpaceMap(RenderSystem* renderer, GameStateSystem* game_state_system, int window_width_px, int window_height_px);
 // render temple map
 void createTempleMap(RenderSystem* renderer, GameStateSystem* game_state_system, int window_width_px, int window_height_px);
+// streamed textures the map of the current state and level draws
+std::vector<TEXTURE_ASSET_ID> getMapTextures(GameStateSystem* game_state_system);
 // render death screen
 void createDeathScreen(RenderSystem* renderer, GameStateSystem* game_state_system, const vec2& position, const vec2& size);
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <cassert>
 #include <sstream>
 #include "physics_system.hpp"
+#include "fixed_point.hpp"
 #include "stat_util.cpp"
 #include "create_gun_util.cpp"
 
@@ -73,6 +74,9 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 
 	for (int i = (int)motion_container.components.size() - 1; i >= 0; --i) {
 		Motion& motion = motion_container.components[i];
+		// Sleeping bodies have not moved since they fell asleep
+		if (motion.is_sleeping)
+			continue;
 		if (motion.position.x + abs(motion.scale.x) < -sideBoundaryOffset || motion.position.x + abs(motion.scale.x) > window_width_px + sideBoundaryOffset ||
 			motion.position.y + abs(motion.scale.y) > window_height_px) {
 			if (!registry.players.has(motion_container.entities[i]) && (registry.bullets.has(motion_container.entities[i]) || registry.nonInteractables.has(motion_container.entities[i]))) {
@@ -80,28 +84,6 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 			}
 		}
 	}
-	// Enable and disable platform colliders based on player position
-	Motion& playerMotion = registry.motions.get(player);
-	Motion& playerMotion2 = registry.motions.get(player2);
-
-	for (Entity entity : registry.platforms.entities) {
-		Motion& platformMotion = registry.motions.get(entity);
-		Platform& platform = registry.platforms.get(entity);
-
-		if ((playerMotion.position.y + playerMotion.scale.y / 2.0f) <= (platformMotion.position.y - platformMotion.scale.y / 2.0f)) {
-			platform.collider_active_player1 = true;
-		}
-		else {
-			platform.collider_active_player1 = false;
-		}
-
-		if ((playerMotion2.position.y + playerMotion2.scale.y / 2.0f) <= (platformMotion.position.y - platformMotion.scale.y / 2.0f)) {
-			platform.collider_active_player2 = true;
-		}
-		else {
-			platform.collider_active_player2 = false;
-		}
-	}
 
 	// Decrement timers in the PlayerStatModifier and Invincibility
 	for (Entity playerEntity : registry.players.entities) {
@@ -285,6 +267,9 @@ void WorldSystem::restart_game() {
 	// Debugging for memory/component leaks
 	//registry.list_all_components();
 
+	// Start loading the level's backgrounds, the previous level's become evictable
+	renderer->requireTextures(getMapTextures(game_state_system));
+
 	// TODO: USE ISLAND MAP FOR TUTORIAL
 	// ISLAND MAP
 	if (game_state_system->get_current_state() == 3) {
@@ -366,74 +351,12 @@ Entity WorldSystem::spawn_player(vec2 player_location, vec3 player_color, Keybin
 // Compute collisions between entities
 void WorldSystem::handle_collisions() {
 
-	handle_player_platform_collisions();
+	PhysicsSystem::resolvePlatformContacts();
 	handle_player_powerup_collisions();
 	handle_player_bullet_collisions();
 	handle_player_mystery_box_collisions();
 }
 
-void WorldSystem::handle_player_platform_collisions() {
-	auto& playerPlatformCollisionsRegistry = registry.playerPlatformCollisions;
-	// Flag to check if there are no player-platform collisions
-	bool noPlayer1PlatformCollisions = true;
-	bool noPlayer2PlatformCollisions = true;
-
-	// Loop over all player platform collisions
-	for (uint i = 0; i < playerPlatformCollisionsRegistry.components.size(); i++) {
-		// The entity and its collider
-		Entity entity = playerPlatformCollisionsRegistry.entities[i];
-		Entity entity_other = playerPlatformCollisionsRegistry.components[i].other_entity;
-
-		// Player platform collisions
-		if (registry.players.has(entity) && registry.platforms.has(entity_other)) {
-
-			Motion& playerMotion = registry.motions.get(entity);
-			Motion& platformMotion = registry.motions.get(entity_other);
-			Platform& platform = registry.platforms.get(entity_other);
-
-			// Player model intersects the platform
-			Player& curr_player = registry.players.get(entity);
-
-			bool players_collider_active = platform.collider_active_player1;
-
-			if (entity == player2) {
-				players_collider_active = platform.collider_active_player2;
-			}
-
-			if (playerMotion.velocity.y > 0 && players_collider_active) {
-				playerMotion.position.y = platformMotion.position.y - (platformMotion.scale.y / 2.0f) - (playerMotion.scale.y / 2.0f);
-				curr_player.is_grounded = true;
-				curr_player.jump_remaining = curr_player.max_jumps;
-				playerMotion.velocity.y = 0;
-
-				if (entity == player) {
-					noPlayer1PlatformCollisions = false;
-				}
-				else if (entity == player2) {
-					noPlayer2PlatformCollisions = false;
-				}
-			}
-		}
-	}
-
-	Player& player_object = registry.players.get(player);
-
-	// if there are no player platform collisions, the player is not grounded
-	if (noPlayer1PlatformCollisions) {
-		player_object.is_grounded = false;
-	}
-
-	Player& player2_object = registry.players.get(player2);
-
-	// if there are no player platform collisions, the player 2 is not grounded
-	if (noPlayer2PlatformCollisions) {
-		player2_object.is_grounded = false;
-	}
-
-	// Remove all collisions from player-platform
-	registry.playerPlatformCollisions.clear();
-}
-
 void WorldSystem::handle_player_powerup_collisions() {
 	auto& playerPowerUpCollisionsRegistry = registry.playerPowerUpCollisions;
 	// Loop over all player powerup collisions
@@ -490,10 +413,7 @@ void WorldSystem::handle_player_bullet_collisions() {
 
 		// Player-bullet collisions
 		if (registry.players.has(entity) && registry.bullets.has(entity_other)) {
-			Player& hit_player = registry.players.get(entity);
-			Motion& playerMotion = registry.motions.get(entity);
 			Invincibility& invincibility = registry.invincibility.get(entity);
-			Bullet& bullet = registry.bullets.get(entity_other);
 
 			if (invincibility.has_TIMER) {
 				continue;
@@ -501,39 +421,7 @@ void WorldSystem::handle_player_bullet_collisions() {
 						
 			sound_system->play_hit_sound();
 
-			if (bullet.isHitscan) {
-
-				printf("HITSCAN KNOCKBACK: %f\n", bullet.knockback);
-				playerMotion.velocity.x += bullet.knockback;
-
-			} else {
-				Motion& bullet_motion = registry.motions.get(entity_other);
-				
-				float distanceTravelled = abs(bullet_motion.position.x - bullet.originalXPosition);
-
-				if (bullet.hasNormalDropOff) {
-					float dropOffPenalty = distanceTravelled * 0.5 * bullet.distanceStrengthModifier;
-
-					if (dropOffPenalty >= bullet.knockback) {
-						dropOffPenalty = bullet.knockback;
-					}
-
-					float knockbackWithDropOff = bullet.knockback - dropOffPenalty;
-
-					printf("KNOCKBACK WITH PENALTY: %f\n", knockbackWithDropOff * hit_player.knockback_resistance);
-
-					playerMotion.velocity.x += knockbackWithDropOff * (bullet_motion.velocity.x < 0 ? -1 : 1) * hit_player.knockback_resistance; 
-				} else {
-					float distanceBonus = distanceTravelled * bullet.distanceStrengthModifier;
-
-					float knockbackWithBonus = bullet.knockback + distanceBonus;
-
-					printf("KNOCKBACK WITH BONUS: %f\n", knockbackWithBonus * hit_player.knockback_resistance);
-
-					playerMotion.velocity.x += knockbackWithBonus * (bullet_motion.velocity.x < 0 ? -1 : 1) * hit_player.knockback_resistance; 
-				}
-			}
-
+			PhysicsSystem::applyBulletKnockback(entity, entity_other);
 
 			registry.remove_all_components_of(entity_other);
 		}
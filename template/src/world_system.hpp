@@ -79,7 +79,6 @@ private:
 	std::uniform_int_distribution<int> uniform_dist_int; // number between 0..1
 
 	// private methods
-	void handle_player_platform_collisions();
     void handle_player_powerup_collisions();
     void handle_player_bullet_collisions();
 	void handle_player_mystery_box_collisions();
@@ -0,0 +1,186 @@
+// Replays a match through the movement and physics systems at a fixed step, hitting the players
+// with bullets along the way, and writes PhysicsSystem::state_hash() after every step. CMake builds this once at -O0 and once at -O2,
+// both with DETERMINISTIC_PHYSICS, and the test fails if the -O2 build diverges from the -O0 hashes.
+//
+// physics_determinism --write <hash file> [match file]
+// physics_determinism --compare <hash file> [match file]
+//
+// Without a match file the scripted benchmark match is replayed.
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "common.hpp"
+#include "tiny_ecs_registry.hpp"
+#include "match_recording.hpp"
+#include "movement_system.hpp"
+#include "physics_system.hpp"
+
+// Same step as the headless benchmark
+const float STEP_MS = 1000.f / 60.f;
+const float MATCH_MS = 20000.f;
+// A bullet hits one of the players every that many steps
+const int HIT_PERIOD_STEPS = 37;
+
+// Platforms of the island map, see createIslandMap
+static void create_platform(vec2 position, vec2 size)
+{
+	Entity entity;
+	Motion& motion = registry.motions.emplace(entity);
+	motion.position = position;
+	motion.scale = size;
+	registry.platforms.emplace(entity);
+	registry.restingBodies.emplace(entity);
+}
+
+// The physics components of createPlayer
+static Entity create_player(vec2 position, Keybinds keybinds)
+{
+	Entity entity;
+	Motion& motion = registry.motions.emplace(entity);
+	motion.position = position;
+	motion.scale = { 60, 60 };
+	registry.gravity.emplace(entity);
+	registry.friction.emplace(entity);
+	registry.players.emplace(entity).keybinds = keybinds;
+	registry.controllers.emplace(entity);
+	return entity;
+}
+
+// Hits the player with a bullet fired from from_x, cycling through hitscan, drop off and distance
+// bonus bullets, as WorldSystem::handle_player_bullet_collisions does
+static void hit_player(Entity player, float from_x, int kind)
+{
+	const Motion& player_motion = registry.motions.get(player);
+	Entity entity;
+	Motion& motion = registry.motions.emplace(entity);
+	motion.position = player_motion.position;
+	motion.velocity = { player_motion.position.x < from_x ? -600.f : 600.f, 0.f };
+	Bullet& bullet = registry.bullets.emplace(entity);
+	bullet.originalXPosition = from_x;
+	bullet.isHitscan = kind == 0;
+	bullet.hasNormalDropOff = kind == 1;
+	bullet.distanceStrengthModifier = kind == 1 ? 0.3f : 0.7f;
+	bullet.knockback = kind == 0 ? 350.f : 500.f;
+	registry.players.get(player).knockback_resistance = kind == 2 ? 0.75f : 1.f;
+
+	PhysicsSystem::applyBulletKnockback(player, entity);
+	registry.remove_all_components_of(entity);
+}
+
+// Applies a key event to the controller of the player bound to it, as WorldSystem::handle_player does
+static void apply_key(const MatchEvent& event)
+{
+	if (event.action != GLFW_PRESS && event.action != GLFW_RELEASE)
+		return;
+	const bool pressed = event.action == GLFW_PRESS;
+	for (uint i = 0; i < registry.players.size(); i++)
+	{
+		const Keybinds& keys = registry.players.components[i].keybinds;
+		Controller& controller = registry.controllers.get(registry.players.entities[i]);
+		if (event.key == keys.left)
+			controller.leftKey = pressed;
+		else if (event.key == keys.right)
+			controller.rightKey = pressed;
+		else if (event.key == keys.up)
+			controller.upKey = pressed;
+		else if (event.key == keys.down)
+			controller.downKey = pressed;
+		else if (event.key == keys.bullet)
+			controller.fireKey = pressed;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3 || (strcmp(argv[1], "--write") != 0 && strcmp(argv[1], "--compare") != 0))
+	{
+		fprintf(stderr, "Usage: %s --write|--compare <hash file> [match file]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	const bool compare = strcmp(argv[1], "--compare") == 0;
+	const char* hash_path = argv[2];
+
+	MatchRecording match = MatchRecording::scripted(MATCH_MS);
+	if (argc > 3 && !match.load(argv[3]))
+		return EXIT_FAILURE;
+	float match_ms = MATCH_MS;
+	if (!match.events.empty())
+		match_ms = std::max(match_ms, match.events.back().time_ms + 1000.f);
+
+	create_platform({ 390, 130 }, { 305, 10 });
+	create_platform({ 410, 220 }, { 400, 10 });
+	create_platform({ 475, 310 }, { 580, 10 });
+	create_platform({ 525, 415 }, { 745, 10 });
+	create_platform({ 605, 530 }, { 950, 10 });
+	Entity players[] = {
+		create_player({ 300, 200 }, { GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_G, GLFW_KEY_H }),
+		create_player({ 700, 200 }, { GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_LEFT, GLFW_KEY_RIGHT, GLFW_KEY_SEMICOLON, GLFW_KEY_APOSTROPHE }) };
+
+	// Same order as the game loop
+	MovementSystem movement_system;
+	PhysicsSystem physics_system;
+	std::vector<uint64_t> hashes;
+	for (match.clock_ms = 0.f; match.clock_ms < match_ms; match.clock_ms += STEP_MS)
+	{
+		MatchEvent event;
+		while (match.next(event))
+			apply_key(event);
+		movement_system.step(STEP_MS);
+		physics_system.step(STEP_MS);
+		PhysicsSystem::resolvePlatformContacts();
+		const int step = (int)hashes.size();
+		if (step % HIT_PERIOD_STEPS == 0)
+		{
+			// Each player is shot from the other one's position
+			const int target = (step / HIT_PERIOD_STEPS) % 2;
+			const float from_x = registry.motions.get(players[1 - target]).position.x;
+			hit_player(players[target], from_x, (step / HIT_PERIOD_STEPS) % 3);
+		}
+		hashes.push_back(PhysicsSystem::state_hash());
+	}
+
+	if (!compare)
+	{
+		FILE* file = fopen(hash_path, "w");
+		if (file == nullptr)
+		{
+			fprintf(stderr, "Could not write %s\n", hash_path);
+			return EXIT_FAILURE;
+		}
+		for (uint64_t hash : hashes)
+			fprintf(file, "%016" PRIx64 "\n", hash);
+		fclose(file);
+		printf("Wrote %zu step hashes to %s\n", hashes.size(), hash_path);
+		return EXIT_SUCCESS;
+	}
+
+	FILE* file = fopen(hash_path, "r");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "Could not read %s\n", hash_path);
+		return EXIT_FAILURE;
+	}
+	size_t step = 0;
+	uint64_t expected = 0;
+	while (fscanf(file, "%" SCNx64, &expected) == 1)
+	{
+		if (step >= hashes.size() || hashes[step] != expected)
+		{
+			fclose(file);
+			fprintf(stderr, "Physics diverged at step %zu (%.1f ms)\n", step, step * STEP_MS);
+			return EXIT_FAILURE;
+		}
+		step++;
+	}
+	fclose(file);
+	if (step != hashes.size())
+	{
+		fprintf(stderr, "Expected %zu step hashes, %s has %zu\n", hashes.size(), hash_path, step);
+		return EXIT_FAILURE;
+	}
+	printf("All %zu steps match %s\n", step, hash_path);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,61 @@
+// Lands a player on a platform, removes the platform and checks that the player is no longer
+// grounded. The contact of a removed platform has to reach resolvePlatformContacts as an End.
+
+#include <cstdio>
+
+#include "common.hpp"
+#include "tiny_ecs_registry.hpp"
+#include "physics_system.hpp"
+
+// Same step as the headless benchmark
+const float STEP_MS = 1000.f / 60.f;
+const int MAX_FALL_STEPS = 120;
+
+static int fail(const char* message)
+{
+	fprintf(stderr, "%s\n", message);
+	return EXIT_FAILURE;
+}
+
+int main()
+{
+	// Platform top at y = 325, the player starts just above it and falls onto it
+	Entity platform;
+	Motion& platform_motion = registry.motions.emplace(platform);
+	platform_motion.position = { 400, 330 };
+	platform_motion.scale = { 400, 10 };
+	registry.platforms.emplace(platform);
+	registry.restingBodies.emplace(platform);
+
+	Entity entity;
+	Motion& player_motion = registry.motions.emplace(entity);
+	player_motion.position = { 400, 290 };
+	player_motion.scale = { 60, 60 };
+	registry.gravity.emplace(entity);
+	registry.friction.emplace(entity);
+	registry.players.emplace(entity);
+
+	PhysicsSystem physics_system;
+	for (int i = 0; i < MAX_FALL_STEPS && !registry.players.get(entity).is_grounded; i++)
+	{
+		physics_system.step(STEP_MS);
+		PhysicsSystem::resolvePlatformContacts();
+	}
+	const Player& player = registry.players.get(entity);
+	if (!player.is_grounded || player.ground_contacts != 1)
+		return fail("The player never landed on the platform");
+
+	registry.remove_all_components_of(platform);
+	physics_system.step(STEP_MS);
+	PhysicsSystem::resolvePlatformContacts();
+
+	if (player.ground_contacts != 0 || player.is_grounded)
+	{
+		fprintf(stderr, "Still grounded after the platform was removed (%d ground contacts)\n", player.ground_contacts);
+		return EXIT_FAILURE;
+	}
+	if (registry.playerPlatformContacts.size() != 0)
+		return fail("The contact of the removed platform was not erased");
+	printf("Removing the supporting platform ungrounds the player\n");
+	return EXIT_SUCCESS;
+}